@@ -0,0 +1,165 @@
+/*
+ * bitflip - bit-flip analysis
+ *
+ * Provides statistics of which bits differ between data sets, to tell single
+ * bit flips apart from corruption of whole bytes or words. Each word of a
+ * differing line is compared between the first data set and each other data
+ * set by XOR, and the flipped bits are counted with popcount. The number of
+ * flips of each bit position within a word is kept as a histogram, and the
+ * position of each word with more than one flipped bit is printed as soon as
+ * it is found.
+ */
+
+#include <stdio.h>		// NULL, fprintf()
+#include <stdlib.h>		// malloc(), free()
+#include <stdint.h>		// uint64_t
+#include "sbuf.h"
+#include "sbuf_diff.h"
+#include "bitflip.h"
+
+/**********************************************************/
+/*
+ * Allocates and initializes new bit-flip statistics for words of the size and
+ * byte order of the given word comparator, which is at most 8 bytes. Returns
+ * the new structure, or NULL if error.
+ */
+bitflip* bitflip_malloc(sbuf_diff_word* w, FILE* fp) {
+	bitflip* bf;
+	int i;
+
+	// check parameters
+	if (w == NULL || w->size * 8 > BITFLIP_MAX_BITS || fp == NULL) {
+		return NULL;
+	}
+
+	// allocate memory for structure
+	bf = (bitflip*)malloc(sizeof(bitflip));
+	if (bf == NULL) {
+		return NULL;
+	}
+
+	// set default values
+	bf->fp = fp;
+	bf->word = *w;
+	bf->words = 0;
+	bf->bits = 0;
+	bf->single = 0;
+	bf->multi = 0;
+	for (i = 0; i < BITFLIP_MAX_BITS; i++) {
+		bf->hist[i] = 0;
+	}
+
+	return bf;
+}
+
+/**********************************************************/
+/*
+ * Frees the memory used by the given bit-flip statistics.
+ */
+void bitflip_free(bitflip* bf) {
+
+	if (bf != NULL) {
+		free(bf);
+	}
+}
+
+/**********************************************************/
+/*
+ * Adds the flipped bits of the line at the given position, using the given
+ * difference structure of the line to skip words without differences. Each
+ * buffer after the first is compared to the first. Prints the position of
+ * each word with more than one flipped bit. Returns 0 if successful, or -1 if
+ * error.
+ */
+int bitflip_add(bitflip* bf, sbuf** sb, int sb_cnt, size_t pos, sbuf_diff* d) {
+	size_t g;
+	size_t ws;
+	uint64_t w0;
+	uint64_t x;
+	uint64_t bits;
+	int n;
+	int i;
+
+	// check parameters
+	if (bf == NULL || sb == NULL || d == NULL) {
+		return -1;
+	}
+
+	// loop through words with at least one difference
+	g = sbuf_diff_next(d, 0);
+	while (g < d->width) {
+
+		// start of the word, which is partial at the end of the line
+		g -= g % bf->word.size;
+		ws = bf->word.size;
+		if (g + ws > d->width) {
+			ws = d->width - g;
+		}
+
+		// compare each buffer to the first
+		w0 = sbuf_diff_word_value(&bf->word, sb[0], pos + g, ws);
+		for (i = 1; i < sb_cnt; i++) {
+			x = (w0 ^ sbuf_diff_word_value(&bf->word, sb[i], pos + g, ws)) & bf->word.mask;
+			if (x == 0) {
+				continue;
+			}
+
+			// count flipped bits
+			n = __builtin_popcountll(x);
+			bf->words++;
+			bf->bits += n;
+
+			// histogram of bit positions
+			for (bits = x; bits != 0; bits &= bits - 1) {
+				bf->hist[__builtin_ctzll(bits)]++;
+			}
+
+			// single bit flip
+			if (n == 1) {
+				bf->single++;
+			}
+
+			// multi-bit error
+			else {
+				bf->multi++;
+				fprintf(bf->fp, "%08zx  %0*llx  %d bits", pos + g, (int)bf->word.size * 2, (unsigned long long)x, n);
+				if (sb_cnt > 2) {
+					fprintf(bf->fp, "  (file %d)", i);
+				}
+				fprintf(bf->fp, "\n");
+			}
+		}
+
+		// next word
+		g = sbuf_diff_next(d, g + bf->word.size);
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Prints the size of the words and the columns of multi-bit errors.
+ */
+void bitflip_print_header(bitflip* bf) {
+	fprintf(bf->fp, "multi-bit errors of %zu-byte words (position, XOR, flipped bits)\n", bf->word.size);
+}
+
+/**********************************************************/
+/*
+ * Prints the totals and the histogram of flipped bit positions, where bit 0 is
+ * the least significant bit of a word.
+ */
+void bitflip_print_footer(bitflip* bf) {
+	size_t i;
+
+	fprintf(bf->fp, "%zu differing words, %zu flipped bits\n", bf->words, bf->bits);
+	fprintf(bf->fp, "%zu single-bit flips, %zu multi-bit errors\n", bf->single, bf->multi);
+
+	// histogram
+	for (i = 0; i < bf->word.size * 8; i++) {
+		fprintf(bf->fp, "bit %2zu  %zu\n", i, bf->hist[i]);
+	}
+}
+
+/**********************************************************/
@@ -0,0 +1,29 @@
+#ifndef _BITFLIP_H
+#define _BITFLIP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sbuf.h"
+#include "sbuf_diff.h"
+
+#define BITFLIP_MAX_BITS	64	// bits of the largest word
+
+// statistics of flipped bits
+struct bitflip {
+	FILE* fp;		// output
+	sbuf_diff_word word;	// word size and byte order
+	size_t hist[BITFLIP_MAX_BITS];	// number of flips of each bit of a word
+	size_t words;		// number of differing words
+	size_t bits;		// number of flipped bits
+	size_t single;		// number of words with a single flipped bit
+	size_t multi;		// number of words with multiple flipped bits
+};
+typedef struct bitflip bitflip;
+
+bitflip* bitflip_malloc(sbuf_diff_word* w, FILE* fp);
+void bitflip_free(bitflip* bf);
+int bitflip_add(bitflip* bf, sbuf** sb, int sb_cnt, size_t pos, sbuf_diff* d);
+void bitflip_print_header(bitflip* bf);
+void bitflip_print_footer(bitflip* bf);
+
+#endif /* _BITFLIP_H */
@@ -0,0 +1,615 @@
+/*
+ * ckpt - checkpoint
+ *
+ * Provides a checkpoint structure to save the state of a comparison to a file
+ * and restore it later, so that a long comparison can be resumed where it
+ * stopped. The checkpoint includes the options changing the output, the state
+ * and identity of each file and the contents of the context cache. The file is written as text, and is replaced
+ * atomically by writing to a temporary file first.
+ */
+
+#include <stdio.h>		// fopen(), fprintf(), fscanf(), rename()
+#include <stdlib.h>		// malloc(), free()
+#include <string.h>		// strlen(), strcmp(), strdup()
+#include <sys/stat.h>		// struct stat
+#include "llq.h"
+#include "llq_num.h"
+#include "sbuf.h"
+#include "sbuf_cache.h"
+#include "ckpt.h"
+
+#define CKPT_MAGIC		"hexdiff-checkpoint"
+#define CKPT_VERSION		3
+
+/**********************************************************/
+/*
+ * Allocates and initializes a new checkpoint for the given number of files.
+ * Returns the new structure, or NULL if error.
+ */
+ckpt* ckpt_malloc(int file_cnt) {
+	ckpt* ck;
+
+	// check parameters
+	if (file_cnt <= 0) {
+		return NULL;
+	}
+
+	// allocate memory for structure
+	ck = (ckpt*)malloc(sizeof(ckpt));
+	if (ck == NULL) {
+		return NULL;
+	}
+
+	// allocate memory for file states
+	ck->file = (ckpt_file*)calloc(file_cnt, sizeof(ckpt_file));
+	if (ck->file == NULL) {
+		free(ck);
+		return NULL;
+	}
+
+	// set default values
+	ck->width = 0;
+	ck->start_pos = 0;
+	ck->end_pos = 0;
+	ck->flags = 0;
+	ck->context = 0;
+	ck->hl_width = 0;
+	ck->mask = 0;
+	ck->tol_type = 0;
+	ck->tol_eps = 0;
+	ck->tol_rel = 0;
+	ck->max_diff_lines = 0;
+	ck->max_diff_bytes = 0;
+	ck->ignore = NULL;
+	ck->ignore_cnt = 0;
+	ck->file_cnt = file_cnt;
+	ck->pos = 0;
+	ck->context_after = 0;
+	ck->spacer_printed = 0;
+	ck->diff_lines = 0;
+	ck->diff_bytes = 0;
+	ck->out = -1;
+
+	return ck;
+}
+
+/**********************************************************/
+/*
+ * Frees the memory used by the given checkpoint.
+ */
+void ckpt_free(ckpt* ck) {
+	int i;
+
+	if (ck != NULL) {
+		for (i = 0; i < ck->file_cnt; i++) {
+			free(ck->file[i].name);
+		}
+		free(ck->file);
+		free(ck->ignore);
+		free(ck);
+	}
+}
+
+/**********************************************************/
+/*
+ * Saves the given list of ignored differences in the checkpoint. Returns 0 if
+ * successful, or -1 if error.
+ */
+int ckpt_set_ignore(ckpt* ck, llq_list* ignore) {
+	llq_node* node;
+	size_t* tmp;
+	size_t cnt;
+
+	// check parameters
+	if (ck == NULL) {
+		return -1;
+	}
+
+	cnt = (ignore != NULL ? ignore->size : 0);
+	tmp = NULL;
+	if (cnt > 0) {
+		tmp = (size_t*)malloc(sizeof(size_t) * cnt);
+		if (tmp == NULL) {
+			return -1;
+		}
+		cnt = 0;
+		for (node = ignore->head; node != NULL; node = node->next) {
+			tmp[cnt++] = llq_num_value(node);
+		}
+	}
+	free(ck->ignore);
+	ck->ignore = tmp;
+	ck->ignore_cnt = cnt;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Checks that the given list of ignored differences is the same as the list
+ * in the checkpoint, in the same order. Returns 0 if the lists match, or -1 if
+ * not.
+ */
+int ckpt_match_ignore(ckpt* ck, llq_list* ignore) {
+	llq_node* node;
+	size_t cnt;
+
+	// check parameters
+	if (ck == NULL) {
+		return -1;
+	}
+
+	cnt = 0;
+	node = (ignore != NULL ? ignore->head : NULL);
+	for (; node != NULL; node = node->next) {
+		if (cnt >= ck->ignore_cnt || ck->ignore[cnt] != llq_num_value(node)) {
+			return -1;
+		}
+		cnt++;
+	}
+
+	return (cnt == ck->ignore_cnt ? 0 : -1);
+}
+
+/**********************************************************/
+/*
+ * Gets the size, modification time, device and inode of the given file into
+ * the given file state. Virtual files have no status, and are only identified
+ * by name.
+ */
+static void ckpt_stat(ckpt_file* id, sfile* sf) {
+	struct stat buf;
+
+	id->size = sfile_size(sf);
+	id->mtime = 0;
+	id->dev = 0;
+	id->ino = 0;
+	if (sfile_stat(sf, &buf) == 0) {
+		id->mtime = buf.st_mtime;
+		id->dev = buf.st_dev;
+		id->ino = buf.st_ino;
+	}
+}
+
+/**********************************************************/
+/*
+ * Saves the identity of the given file in the checkpoint as file number i, so
+ * that a checkpoint of other files is not resumed. Returns 0 if successful, or
+ * -1 if error.
+ */
+int ckpt_id_file(ckpt* ck, int i, char* name, sfile* sf) {
+	char* tmp;
+
+	// check parameters
+	if (ck == NULL || name == NULL || sf == NULL || i < 0 || i >= ck->file_cnt) {
+		return -1;
+	}
+
+	tmp = strdup(name);
+	if (tmp == NULL) {
+		return -1;
+	}
+	free(ck->file[i].name);
+	ck->file[i].name = tmp;
+	ckpt_stat(&ck->file[i], sf);
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Checks that the given file is the same file, unchanged, as file number i in
+ * the checkpoint. Returns 0 if the file matches, or -1 if not.
+ */
+int ckpt_match_file(ckpt* ck, int i, char* name, sfile* sf) {
+	ckpt_file id;
+
+	// check parameters
+	if (ck == NULL || name == NULL || sf == NULL || i < 0 || i >= ck->file_cnt) {
+		return -1;
+	}
+	if (ck->file[i].name == NULL || strcmp(ck->file[i].name, name) != 0) {
+		return -1;
+	}
+
+	ckpt_stat(&id, sf);
+	if (id.size != ck->file[i].size || id.mtime != ck->file[i].mtime || id.dev != ck->file[i].dev || id.ino != ck->file[i].ino) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Saves the state of the given file and buffer in the checkpoint as file
+ * number i, so that the data of the file continues at the given position when
+ * restored. Data already read into the buffer at or after the position is not
+ * included and will be read again. Returns 0 if successful, or -1 if error.
+ */
+int ckpt_save_file(ckpt* ck, int i, sfile* sf, sbuf* sb, size_t pos) {
+	size_t ahead;
+
+	// check parameters
+	if (ck == NULL || sf == NULL || sb == NULL || i < 0 || i >= ck->file_cnt) {
+		return -1;
+	}
+
+	// data resumes after any NULL bytes before the buffer
+	if (sb->pos > pos) {
+		pos = sb->pos;
+	}
+
+	// bytes read at or after position
+	ahead = 0;
+	if (sb->pos + sb->len > pos) {
+		ahead = (sb->pos + sb->len) - pos;
+	}
+
+	// save state
+	ck->file[i].offset = sf->offset - ahead;
+	ck->file[i].data_pos = pos;
+	ck->file[i].start_pos = sf->start_pos;
+	ck->file[i].bytes_read = sf->bytes_read - ahead;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Restores the state of file number i in the checkpoint to the given file and
+ * buffer. The file must have just been opened, as the file is seeked to the
+ * saved offset with sfile_seek(). Returns 0 if successful, or -1 if error.
+ */
+int ckpt_restore_file(ckpt* ck, int i, sfile* sf, sbuf* sb) {
+
+	// check parameters
+	if (ck == NULL || sf == NULL || sb == NULL || i < 0 || i >= ck->file_cnt) {
+		return -1;
+	}
+
+	// seek to saved offset
+	if (sfile_seek(sf, sb, ck->file[i].offset) < 0) {
+		return -1;
+	}
+
+	// restore state, including data already read into the buffer if the
+	// file could not be seeked
+	sb->pos = ck->file[i].data_pos;
+	sf->start_pos = ck->file[i].start_pos;
+	sf->bytes_read = ck->file[i].bytes_read + sb->len;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Writes the given checkpoint and the active lines of the given caches (one
+ * per file, or NULL if there is no cache) to the file at the given path. The
+ * file is only replaced once the checkpoint has been completely written.
+ * Returns 0 if successful, or -1 if error.
+ */
+int ckpt_write(ckpt* ck, sbuf_cache** cache, char* path) {
+	FILE* fp;
+	char* tmp_path;
+	llq_node* node;
+	sbuf* obj;
+	size_t j;
+	size_t len;
+	int i;
+	int ret;
+
+	// check parameters
+	if (ck == NULL || path == NULL) {
+		return -1;
+	}
+
+	// temporary file name
+	tmp_path = (char*)malloc(strlen(path) + 5);
+	if (tmp_path == NULL) {
+		return -1;
+	}
+	sprintf(tmp_path, "%s.tmp", path);
+
+	// open temporary file
+	fp = fopen(tmp_path, "w");
+	if (fp == NULL) {
+		free(tmp_path);
+		return -1;
+	}
+
+	// write state
+	fprintf(fp, "%s %d\n", CKPT_MAGIC, CKPT_VERSION);
+	fprintf(fp, "width %zu\n", ck->width);
+	fprintf(fp, "start_pos %zu\n", ck->start_pos);
+	fprintf(fp, "end_pos %zu\n", ck->end_pos);
+	fprintf(fp, "flags %d\n", ck->flags);
+	fprintf(fp, "context %zu\n", ck->context);
+	fprintf(fp, "hl_width %zu\n", ck->hl_width);
+	fprintf(fp, "mask %zu\n", ck->mask);
+	fprintf(fp, "tolerance %d %a %d\n", ck->tol_type, ck->tol_eps, ck->tol_rel);
+	fprintf(fp, "max_diff_lines %zu\n", ck->max_diff_lines);
+	fprintf(fp, "max_diff_bytes %zu\n", ck->max_diff_bytes);
+	fprintf(fp, "ignore %zu", ck->ignore_cnt);
+	for (j = 0; j < ck->ignore_cnt; j++) {
+		fprintf(fp, " %zu", ck->ignore[j]);
+	}
+	fprintf(fp, "\n");
+	fprintf(fp, "files %d\n", ck->file_cnt);
+	fprintf(fp, "pos %zu\n", ck->pos);
+	fprintf(fp, "context_after %zu\n", ck->context_after);
+	fprintf(fp, "spacer_printed %d\n", ck->spacer_printed);
+	fprintf(fp, "diff_lines %zu\n", ck->diff_lines);
+	fprintf(fp, "diff_bytes %zu\n", ck->diff_bytes);
+	fprintf(fp, "out %lld\n", (long long)ck->out);
+
+	// write state and identity of each file, the name in hexadecimal
+	for (i = 0; i < ck->file_cnt; i++) {
+		fprintf(fp, "file %d %zu %zu %zu %zu %lld %lld %llu %llu %zu %zu %d\n",
+			i,
+			ck->file[i].offset,
+			ck->file[i].data_pos,
+			ck->file[i].start_pos,
+			ck->file[i].bytes_read,
+			(long long)ck->file[i].size,
+			(long long)ck->file[i].mtime,
+			(unsigned long long)ck->file[i].dev,
+			(unsigned long long)ck->file[i].ino,
+			ck->file[i].seek,
+			ck->file[i].shift,
+			ck->file[i].excl
+		);
+		len = (ck->file[i].name != NULL ? strlen(ck->file[i].name) : 0);
+		fprintf(fp, "name %d %zu ", i, len);
+		for (j = 0; j < len; j++) {
+			fprintf(fp, "%02x", (unsigned char)ck->file[i].name[j]);
+		}
+		fprintf(fp, "\n");
+	}
+
+	// write cache lines in order
+	for (i = 0; i < ck->file_cnt && cache != NULL; i++) {
+		if (cache[i] == NULL) {
+			continue;
+		}
+		node = cache[i]->active.head;
+		while (node != NULL) {
+			obj = (sbuf*)node->obj;
+			fprintf(fp, "cache %d %zu %zu ", i, obj->pos, obj->len);
+			for (j = 0; j < obj->len; j++) {
+				fprintf(fp, "%02x", obj->ptr[j]);
+			}
+			fprintf(fp, "\n");
+			node = node->next;
+		}
+	}
+
+	// end marker, detects truncated files
+	fprintf(fp, "end\n");
+
+	// close and replace checkpoint
+	ret = 0;
+	if (fclose(fp) != 0) {
+		ret = -1;
+	}
+	if (ret == 0 && rename(tmp_path, path) != 0) {
+		ret = -1;
+	}
+	if (ret != 0) {
+		remove(tmp_path);
+	}
+
+	free(tmp_path);
+
+	return ret;
+}
+
+/**********************************************************/
+/*
+ * Reads the checkpoint at the given path into the given checkpoint, which must
+ * have been allocated for the same number of files. Cache lines are appended
+ * to the given caches (one per file), and skipped for files without a cache.
+ * The options of the checkpoint must then be compared with the current
+ * options. Returns 0 if successful, or -1 if error.
+ */
+int ckpt_read(ckpt* ck, sbuf_cache** cache, char* path) {
+	FILE* fp;
+	char key[32];
+	int version;
+	int file_cnt;
+	long long out;
+	long long size;
+	long long mtime;
+	unsigned long long dev;
+	unsigned long long ino;
+	char* name;
+	int i;
+	size_t j;
+	size_t pos;
+	size_t len;
+	unsigned int ch;
+	unsigned char* buf;
+	int ret;
+
+	// check parameters
+	if (ck == NULL || path == NULL) {
+		return -1;
+	}
+
+	// open checkpoint
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		return -1;
+	}
+
+	// check header
+	if (fscanf(fp, "%31s %d", key, &version) != 2 || strcmp(key, CKPT_MAGIC) != 0 || version != CKPT_VERSION) {
+		fclose(fp);
+		return -1;
+	}
+
+	// read fixed state
+	file_cnt = 0;
+	out = -1;
+	ret = 0;
+	ret += fscanf(fp, " width %zu", &ck->width);
+	ret += fscanf(fp, " start_pos %zu", &ck->start_pos);
+	ret += fscanf(fp, " end_pos %zu", &ck->end_pos);
+	ret += fscanf(fp, " flags %d", &ck->flags);
+	ret += fscanf(fp, " context %zu", &ck->context);
+	ret += fscanf(fp, " hl_width %zu", &ck->hl_width);
+	ret += fscanf(fp, " mask %zu", &ck->mask);
+	ret += fscanf(fp, " tolerance %d %la %d", &ck->tol_type, &ck->tol_eps, &ck->tol_rel);
+	ret += fscanf(fp, " max_diff_lines %zu", &ck->max_diff_lines);
+	ret += fscanf(fp, " max_diff_bytes %zu", &ck->max_diff_bytes);
+	ret += fscanf(fp, " ignore %zu", &len);
+	if (ret != 13) {
+		fclose(fp);
+		return -1;
+	}
+
+	// read ignored differences
+	free(ck->ignore);
+	ck->ignore = NULL;
+	ck->ignore_cnt = 0;
+	if (len > 0) {
+		ck->ignore = (size_t*)malloc(sizeof(size_t) * len);
+		if (ck->ignore == NULL) {
+			fclose(fp);
+			return -1;
+		}
+		for (j = 0; j < len; j++) {
+			if (fscanf(fp, " %zu", &ck->ignore[j]) != 1) {
+				fclose(fp);
+				return -1;
+			}
+		}
+		ck->ignore_cnt = len;
+	}
+
+	ret = 0;
+	ret += fscanf(fp, " files %d", &file_cnt);
+	ret += fscanf(fp, " pos %zu", &ck->pos);
+	ret += fscanf(fp, " context_after %zu", &ck->context_after);
+	ret += fscanf(fp, " spacer_printed %d", &ck->spacer_printed);
+	ret += fscanf(fp, " diff_lines %zu", &ck->diff_lines);
+	ret += fscanf(fp, " diff_bytes %zu", &ck->diff_bytes);
+	ret += fscanf(fp, " out %lld", &out);
+	if (ret != 7 || file_cnt != ck->file_cnt) {
+		fclose(fp);
+		return -1;
+	}
+	ck->out = (off_t)out;
+
+	// read state and identity of each file
+	for (i = 0; i < ck->file_cnt; i++) {
+		if (fscanf(fp, " file %*d %zu %zu %zu %zu %lld %lld %llu %llu %zu %zu %d",
+			&ck->file[i].offset,
+			&ck->file[i].data_pos,
+			&ck->file[i].start_pos,
+			&ck->file[i].bytes_read,
+			&size,
+			&mtime,
+			&dev,
+			&ino,
+			&ck->file[i].seek,
+			&ck->file[i].shift,
+			&ck->file[i].excl
+		) != 11) {
+			fclose(fp);
+			return -1;
+		}
+		ck->file[i].size = (off_t)size;
+		ck->file[i].mtime = (time_t)mtime;
+		ck->file[i].dev = (dev_t)dev;
+		ck->file[i].ino = (ino_t)ino;
+
+		// read name
+		if (fscanf(fp, " name %*d %zu ", &len) != 1) {
+			fclose(fp);
+			return -1;
+		}
+		name = (char*)malloc(sizeof(char) * (len + 1));
+		if (name == NULL) {
+			fclose(fp);
+			return -1;
+		}
+		for (j = 0; j < len; j++) {
+			if (fscanf(fp, "%2x", &ch) != 1) {
+				break;
+			}
+			name[j] = ch;
+		}
+		name[j] = '\0';
+		free(ck->file[i].name);
+		ck->file[i].name = name;
+		if (j < len) {
+			fclose(fp);
+			return -1;
+		}
+	}
+
+	// read cache lines until end marker
+	ret = -1;
+	while (fscanf(fp, "%31s", key) == 1) {
+
+		// end of checkpoint
+		if (strcmp(key, "end") == 0) {
+			ret = 0;
+			break;
+		}
+
+		// cache line
+		if (strcmp(key, "cache") != 0) {
+			break;
+		}
+		if (fscanf(fp, "%d %zu %zu ", &i, &pos, &len) != 3) {
+			break;
+		}
+		if (i < 0 || i >= ck->file_cnt) {
+			break;
+		}
+
+		// no cache for the file, the context differs from the one of the
+		// checkpoint, skip the data so that the options are compared
+		if (cache == NULL || cache[i] == NULL) {
+			for (j = 0; j < len; j++) {
+				if (fscanf(fp, "%2x", &ch) != 1) {
+					break;
+				}
+			}
+			if (j < len) {
+				break;
+			}
+			continue;
+		}
+		if (len > cache[i]->max_buf_len) {
+			break;
+		}
+
+		// read data
+		buf = (unsigned char*)malloc(sizeof(unsigned char) * (len + 1));
+		if (buf == NULL) {
+			break;
+		}
+		for (j = 0; j < len; j++) {
+			if (fscanf(fp, "%2x", &ch) != 1) {
+				break;
+			}
+			buf[j] = ch;
+		}
+
+		// add to cache
+		if (j < len || sbuf_cache_append(cache[i], buf, pos, len) == NULL) {
+			free(buf);
+			break;
+		}
+		free(buf);
+	}
+
+	fclose(fp);
+
+	return ret;
+}
+
+/**********************************************************/
@@ -0,0 +1,64 @@
+#ifndef _CKPT_H
+#define _CKPT_H
+
+#include <sys/types.h>
+#include "llq.h"
+#include "sbuf.h"
+#include "sbuf_cache.h"
+
+// state of each file
+struct ckpt_file {
+	size_t offset;		// file offset of the data at data_pos
+	size_t data_pos;	// position where the data of the file resumes
+	size_t start_pos;	// starting position (for calculating length)
+	size_t bytes_read;	// total bytes read up to data_pos
+	char* name;		// name of the file
+	off_t size;		// size of the file, or -1 if unknown
+	time_t mtime;		// modification time of the file
+	dev_t dev;		// device of the file
+	ino_t ino;		// inode of the file
+	size_t seek;		// offset the file was seeked to
+	size_t shift;		// number of NULL bytes the file was shifted by
+	int excl;		// flag to mark the output of the file is excluded
+};
+typedef struct ckpt_file ckpt_file;
+
+// checkpoint
+struct ckpt {
+	size_t width;		// number of bytes per line per file
+	size_t start_pos;	// starting position of output
+	size_t end_pos;		// ending position of output
+	int flags;		// flags changing the output
+	size_t context;		// number of lines of context
+	size_t hl_width;	// number of bytes per word
+	size_t mask;		// mask of the bits of each word compared, or 0 if all
+	int tol_type;		// type of the tolerance of words, or 0 if exact
+	double tol_eps;		// tolerance of words
+	int tol_rel;		// flag to mark the tolerance is relative
+	size_t max_diff_lines;	// number of differing lines to stop after
+	size_t max_diff_bytes;	// number of differing bytes to stop after
+	size_t* ignore;		// ignored differences
+	size_t ignore_cnt;	// number of ignored differences
+	int file_cnt;		// number of files
+	size_t pos;		// position of the next line
+	size_t context_after;	// number of context lines printed after a difference
+	int spacer_printed;	// flag to mark a spacer has been printed
+	size_t diff_lines;	// number of lines with differences
+	size_t diff_bytes;	// number of differing bytes
+	off_t out;		// offset of output, or -1 if unknown
+	ckpt_file* file;	// state of each file
+};
+typedef struct ckpt ckpt;
+
+ckpt* ckpt_malloc(int file_cnt);
+void ckpt_free(ckpt* ck);
+int ckpt_set_ignore(ckpt* ck, llq_list* ignore);
+int ckpt_match_ignore(ckpt* ck, llq_list* ignore);
+int ckpt_id_file(ckpt* ck, int i, char* name, sfile* sf);
+int ckpt_match_file(ckpt* ck, int i, char* name, sfile* sf);
+int ckpt_save_file(ckpt* ck, int i, sfile* sf, sbuf* sb, size_t pos);
+int ckpt_restore_file(ckpt* ck, int i, sfile* sf, sbuf* sb);
+int ckpt_write(ckpt* ck, sbuf_cache** cache, char* path);
+int ckpt_read(ckpt* ck, sbuf_cache** cache, char* path);
+
+#endif /* _CKPT_H */
@@ -0,0 +1,395 @@
+/*
+ * delta - difference value analytics
+ *
+ * Provides a summary of the difference values of words, as displayed line by
+ * line with -d, over the whole range instead of printing each line. Each
+ * differing word is read from the subtraction buffer of its line and counted
+ * in a hash table of distinct values, so that the most frequent differences
+ * can be reported as candidates to ignore. The words with the largest absolute
+ * differences are kept in a min-heap bounded by the number of words to report,
+ * so that only the smallest of them needs to be compared against each new
+ * word. Both are reported once the whole range has been compared.
+ */
+
+#include <stdio.h>		// NULL, fprintf()
+#include <stdlib.h>		// malloc(), calloc(), free(), qsort()
+#include <stdint.h>		// uint64_t
+#include "sbuf.h"
+#include "sbuf_diff.h"
+#include "delta.h"
+
+#define DELTA_TAB_SIZE		1024	// initial number of slots of the hash table
+
+/**********************************************************/
+/*
+ * Returns the slot of the hash table for the given value, using multiplicative
+ * hashing so that small and sequential values are spread over the table.
+ */
+static size_t delta_hash(delta* dt, uint64_t value) {
+	return (size_t)((value * 0x9e3779b97f4a7c15ULL) >> 32) & (dt->tab_size - 1);
+}
+
+/**********************************************************/
+/*
+ * Doubles the number of slots of the hash table, moving every value to its new
+ * slot. Returns 0 if successful, or -1 if error.
+ */
+static int delta_grow(delta* dt) {
+	delta_value* old;
+	size_t old_size;
+	size_t i;
+	size_t s;
+
+	// allocate larger table
+	old = dt->tab;
+	old_size = dt->tab_size;
+	dt->tab = (delta_value*)calloc(old_size * 2, sizeof(delta_value));
+	if (dt->tab == NULL) {
+		dt->tab = old;
+		return -1;
+	}
+	dt->tab_size = old_size * 2;
+
+	// move values, probing linearly
+	for (i = 0; i < old_size; i++) {
+		if (old[i].cnt > 0) {
+			s = delta_hash(dt, old[i].value);
+			while (dt->tab[s].cnt > 0) {
+				s = (s + 1) & (dt->tab_size - 1);
+			}
+			dt->tab[s] = old[i];
+		}
+	}
+
+	free(old);
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Counts one word with the given difference value. Once the table holds the
+ * maximum number of distinct values, words with new values are only counted
+ * as untracked.
+ */
+static void delta_count(delta* dt, uint64_t value) {
+	size_t s;
+
+	// find value or empty slot, probing linearly
+	s = delta_hash(dt, value);
+	while (dt->tab[s].cnt > 0 && dt->tab[s].value != value) {
+		s = (s + 1) & (dt->tab_size - 1);
+	}
+
+	// existing value
+	if (dt->tab[s].cnt > 0) {
+		dt->tab[s].cnt++;
+		return;
+	}
+
+	// table is full
+	if (dt->tab_cnt >= DELTA_MAX_VALUES) {
+		dt->untracked++;
+		return;
+	}
+
+	// new value
+	dt->tab[s].value = value;
+	dt->tab[s].cnt = 1;
+	dt->tab_cnt++;
+
+	// keep table at most half full
+	if (dt->tab_cnt * 2 >= dt->tab_size && dt->tab_cnt < DELTA_MAX_VALUES) {
+		delta_grow(dt);
+	}
+}
+
+/**********************************************************/
+/*
+ * Returns the given difference value of a word of the given number of bytes as
+ * a signed value, the way a subtraction of two's complement words wraps.
+ */
+static long long delta_signed(uint64_t value, size_t ws) {
+	uint64_t sign;
+
+	// whole 64-bit word
+	if (ws * 8 >= DELTA_MAX_BITS) {
+		return (long long)value;
+	}
+
+	// extend sign bit
+	sign = (uint64_t)1 << (ws * 8 - 1);
+	if (value & sign) {
+		value |= ~(uint64_t)0 << (ws * 8);
+	}
+
+	return (long long)value;
+}
+
+/**********************************************************/
+/*
+ * Returns non-zero if the first word is a smaller difference than the second,
+ * where the later position is the smaller of equal magnitudes so that the
+ * earliest words are kept.
+ */
+static int delta_less(delta_word* a, delta_word* b) {
+	if (a->mag != b->mag) {
+		return a->mag < b->mag;
+	}
+	return a->pos > b->pos;
+}
+
+/**********************************************************/
+/*
+ * Moves the word at the given index of the min-heap down until neither of its
+ * children is smaller.
+ */
+static void delta_sift(delta* dt, size_t i) {
+	delta_word tmp;
+	size_t c;
+
+	while ((c = (2 * i) + 1) < dt->heap_cnt) {
+
+		// smaller child
+		if (c + 1 < dt->heap_cnt && delta_less(&dt->heap[c + 1], &dt->heap[c])) {
+			c++;
+		}
+
+		// heap order holds
+		if (! delta_less(&dt->heap[c], &dt->heap[i])) {
+			break;
+		}
+
+		tmp = dt->heap[i];
+		dt->heap[i] = dt->heap[c];
+		dt->heap[c] = tmp;
+		i = c;
+	}
+}
+
+/**********************************************************/
+/*
+ * Keeps the given word if it is among the largest differences so far. Until the
+ * heap is full every word is kept, afterwards a word only replaces the
+ * smallest one at the root of the heap.
+ */
+static void delta_keep(delta* dt, delta_word* w) {
+	delta_word tmp;
+	size_t i;
+	size_t p;
+
+	// heap is not full, move new word up from the last leaf
+	if (dt->heap_cnt < dt->top) {
+		i = dt->heap_cnt++;
+		dt->heap[i] = *w;
+		while (i > 0) {
+			p = (i - 1) / 2;
+			if (! delta_less(&dt->heap[i], &dt->heap[p])) {
+				break;
+			}
+			tmp = dt->heap[i];
+			dt->heap[i] = dt->heap[p];
+			dt->heap[p] = tmp;
+			i = p;
+		}
+	}
+
+	// replace the smallest word
+	else if (delta_less(&dt->heap[0], w)) {
+		dt->heap[0] = *w;
+		delta_sift(dt, 0);
+	}
+}
+
+/**********************************************************/
+/*
+ * Compares difference values by decreasing count, then by increasing value,
+ * for qsort().
+ */
+static int delta_cmp_value(const void* a, const void* b) {
+	const delta_value* va = (const delta_value*)a;
+	const delta_value* vb = (const delta_value*)b;
+
+	if (va->cnt != vb->cnt) {
+		return va->cnt < vb->cnt ? 1 : -1;
+	}
+	if (va->value != vb->value) {
+		return va->value > vb->value ? 1 : -1;
+	}
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Compares words by decreasing magnitude, then by increasing position, for
+ * qsort().
+ */
+static int delta_cmp_word(const void* a, const void* b) {
+	const delta_word* wa = (const delta_word*)a;
+	const delta_word* wb = (const delta_word*)b;
+
+	if (wa->mag != wb->mag) {
+		return wa->mag < wb->mag ? 1 : -1;
+	}
+	if (wa->pos != wb->pos) {
+		return wa->pos > wb->pos ? 1 : -1;
+	}
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Allocates and initializes new difference statistics for words of the size
+ * and byte order of the given word comparator, which is at most 8 bytes,
+ * reporting the given number of most frequent values and largest differences.
+ * Returns the new structure, or NULL if error.
+ */
+delta* delta_malloc(sbuf_diff_word* w, size_t top, FILE* fp) {
+	delta* dt;
+
+	// check parameters
+	if (w == NULL || w->size * 8 > DELTA_MAX_BITS || top == 0 || fp == NULL) {
+		return NULL;
+	}
+
+	// allocate memory for structure
+	dt = (delta*)malloc(sizeof(delta));
+	if (dt == NULL) {
+		return NULL;
+	}
+
+	// allocate hash table
+	dt->tab = (delta_value*)calloc(DELTA_TAB_SIZE, sizeof(delta_value));
+	if (dt->tab == NULL) {
+		free(dt);
+		return NULL;
+	}
+
+	// allocate heap
+	dt->heap = (delta_word*)malloc(top * sizeof(delta_word));
+	if (dt->heap == NULL) {
+		free(dt->tab);
+		free(dt);
+		return NULL;
+	}
+
+	// set default values
+	dt->fp = fp;
+	dt->word = *w;
+	dt->top = top;
+	dt->tab_size = DELTA_TAB_SIZE;
+	dt->tab_cnt = 0;
+	dt->heap_cnt = 0;
+	dt->words = 0;
+	dt->untracked = 0;
+
+	return dt;
+}
+
+/**********************************************************/
+/*
+ * Frees the memory used by the given difference statistics.
+ */
+void delta_free(delta* dt) {
+
+	if (dt != NULL) {
+		free(dt->tab);
+		free(dt->heap);
+		free(dt);
+	}
+}
+
+/**********************************************************/
+/*
+ * Adds the difference values of the line at the given position, read from the
+ * subtraction buffer of the given difference structure, and skipping words
+ * without differences. Returns 0 if successful, or -1 if error.
+ */
+int delta_add(delta* dt, size_t pos, sbuf_diff* d) {
+	delta_word w;
+	size_t g;
+	long long s;
+
+	// check parameters
+	if (dt == NULL || d == NULL || d->sub == NULL) {
+		return -1;
+	}
+
+	// loop through words with at least one difference
+	g = sbuf_diff_next(d, 0);
+	while (g < d->sub->len) {
+
+		// start of the word, which is padded at the end of the line
+		g -= g % dt->word.size;
+
+		// difference value as displayed with -d and matched by -I
+		w.value = sbuf_diff_word_value(&dt->word, d->sub, d->sub->pos + g, dt->word.size);
+		s = delta_signed(w.value, dt->word.size);
+		w.mag = (s < 0 ? -(uint64_t)s : (uint64_t)s);
+		w.pos = pos + g;
+
+		dt->words++;
+		delta_count(dt, w.value);
+		delta_keep(dt, &w);
+
+		// next word
+		g = sbuf_diff_next(d, g + dt->word.size);
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Prints the size of the words and the number of values and words reported.
+ */
+void delta_print_header(delta* dt) {
+	fprintf(dt->fp, "top %zu differences of %zu-byte words (file 1 subtract file 0)\n", dt->top, dt->word.size);
+}
+
+/**********************************************************/
+/*
+ * Prints the totals, the most frequent difference values with their number of
+ * words, and the largest differences with their positions. Values are printed
+ * in hexadecimal as accepted by -I, followed by their signed value. The table
+ * and heap are sorted in place, so no more words can be added afterwards.
+ */
+void delta_print_footer(delta* dt) {
+	size_t i;
+	size_t n;
+	int digits;
+
+	digits = (int)dt->word.size * 2;
+
+	// totals
+	fprintf(dt->fp, "%zu differing words, %zu distinct differences", dt->words, dt->tab_cnt);
+	if (dt->untracked > 0) {
+		fprintf(dt->fp, ", %zu words not counted", dt->untracked);
+	}
+	fprintf(dt->fp, "\n");
+
+	// most frequent values, gathered at the start of the table
+	n = 0;
+	for (i = 0; i < dt->tab_size; i++) {
+		if (dt->tab[i].cnt > 0) {
+			dt->tab[n++] = dt->tab[i];
+		}
+	}
+	qsort(dt->tab, n, sizeof(delta_value), delta_cmp_value);
+	if (n > dt->top) {
+		n = dt->top;
+	}
+	fprintf(dt->fp, "most frequent (difference, signed, words)\n");
+	for (i = 0; i < n; i++) {
+		fprintf(dt->fp, "0x%0*llx  %lld  %zu\n", digits, (unsigned long long)dt->tab[i].value, delta_signed(dt->tab[i].value, dt->word.size), dt->tab[i].cnt);
+	}
+
+	// largest differences
+	qsort(dt->heap, dt->heap_cnt, sizeof(delta_word), delta_cmp_word);
+	fprintf(dt->fp, "largest (position, difference, signed)\n");
+	for (i = 0; i < dt->heap_cnt; i++) {
+		fprintf(dt->fp, "%08zx  0x%0*llx  %lld\n", dt->heap[i].pos, digits, (unsigned long long)dt->heap[i].value, delta_signed(dt->heap[i].value, dt->word.size));
+	}
+}
+
+/**********************************************************/
@@ -0,0 +1,47 @@
+#ifndef _DELTA_H
+#define _DELTA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sbuf_diff.h"
+
+#define DELTA_MAX_BITS		64		// bits of the largest word
+#define DELTA_MAX_VALUES	1048576		// distinct differences counted
+
+// number of words with a difference value
+struct delta_value {
+	uint64_t value;		// difference value
+	size_t cnt;		// number of words, 0 if unused
+};
+typedef struct delta_value delta_value;
+
+// word with a large difference
+struct delta_word {
+	uint64_t mag;		// absolute difference
+	uint64_t value;		// difference value
+	size_t pos;		// position of the word
+};
+typedef struct delta_word delta_word;
+
+// statistics of difference values
+struct delta {
+	FILE* fp;		// output
+	sbuf_diff_word word;	// word size and byte order
+	size_t top;		// number of values and words to report
+	delta_value* tab;	// hash table of difference values
+	size_t tab_size;	// number of slots, a power of two
+	size_t tab_cnt;		// number of distinct values in the table
+	delta_word* heap;	// min-heap of the largest differences
+	size_t heap_cnt;	// number of words in the heap
+	size_t words;		// number of differing words
+	size_t untracked;	// words whose value did not fit in the table
+};
+typedef struct delta delta;
+
+delta* delta_malloc(sbuf_diff_word* w, size_t top, FILE* fp);
+void delta_free(delta* dt);
+int delta_add(delta* dt, size_t pos, sbuf_diff* d);
+void delta_print_header(delta* dt);
+void delta_print_footer(delta* dt);
+
+#endif /* _DELTA_H */
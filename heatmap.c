@@ -0,0 +1,250 @@
+/*
+ * heatmap - difference density map
+ *
+ * Provides a compact map of where differences are located, instead of
+ * printing each line. The range is divided into buckets of a fixed number of
+ * bytes, and the number of differing bytes of each bucket is either drawn as
+ * one character of a text minimap, or printed as one line of a data series.
+ * Each row of the minimap (or line of the series) is printed as soon as it is
+ * complete, so no more than one row is kept in memory.
+ */
+
+#include <stdio.h>		// NULL, fprintf()
+#include <stdlib.h>		// malloc(), free()
+#include "heatmap.h"
+
+// characters of the minimap, from no differences to all bytes differing
+#define HEATMAP_SCALE		" .:-=+*#%@"
+#define HEATMAP_LEVELS		9
+
+/**********************************************************/
+/*
+ * Returns the index of the highest bit set in the given value, or 0 if none.
+ */
+static int heatmap_log2(size_t n) {
+	int i;
+
+	for (i = 0; n > 1; i++) {
+		n >>= 1;
+	}
+
+	return i;
+}
+
+/**********************************************************/
+/*
+ * Returns the character of the minimap for the given number of differing
+ * bytes. The scale is logarithmic, so that a single differing byte is still
+ * visible and a bucket of only differing bytes has the highest level.
+ */
+static char heatmap_char(heatmap* hm, size_t cnt) {
+	int bits;
+	int level;
+
+	// no differences
+	if (cnt == 0) {
+		return HEATMAP_SCALE[0];
+	}
+
+	// level according to the magnitude of the count
+	bits = heatmap_log2(hm->bucket);
+	level = HEATMAP_LEVELS;
+	if (bits > 0) {
+		level = 1 + (heatmap_log2(cnt) * (HEATMAP_LEVELS - 1)) / bits;
+	}
+	if (level > HEATMAP_LEVELS) {
+		level = HEATMAP_LEVELS;
+	}
+
+	return HEATMAP_SCALE[level];
+}
+
+/**********************************************************/
+/*
+ * Prints the current row of the minimap, which holds the given number of
+ * buckets.
+ */
+static void heatmap_print_row(heatmap* hm, size_t n) {
+	size_t i;
+	size_t sum;
+
+	// position of the first bucket in the row
+	fprintf(hm->fp, "%08zx  |", hm->start_pos + ((hm->idx - (n - 1)) * hm->bucket));
+
+	// one character per bucket
+	sum = 0;
+	for (i = 0; i < HEATMAP_ROW; i++) {
+		if (i < n) {
+			fputc(heatmap_char(hm, hm->cnt[i]), hm->fp);
+			sum += hm->cnt[i];
+		}
+		else {
+			fputc(' ', hm->fp);
+		}
+	}
+
+	// differing bytes of the row
+	fprintf(hm->fp, "|  %zu\n", sum);
+}
+
+/**********************************************************/
+/*
+ * Completes the current bucket, printing it as part of the series or of a
+ * complete row, and moves to the next bucket.
+ */
+static void heatmap_next(heatmap* hm) {
+	size_t i;
+
+	i = hm->idx % HEATMAP_ROW;
+
+	if (hm->cnt[i] > 0) {
+		hm->used++;
+	}
+
+	// data series
+	if (hm->series) {
+		fprintf(hm->fp, "%08zx %zu\n", hm->start_pos + (hm->idx * hm->bucket), hm->cnt[i]);
+	}
+
+	// minimap, row is complete
+	else if (i == HEATMAP_ROW - 1) {
+		heatmap_print_row(hm, HEATMAP_ROW);
+	}
+
+	// clear the row once complete
+	if (i == HEATMAP_ROW - 1) {
+		for (i = 0; i < HEATMAP_ROW; i++) {
+			hm->cnt[i] = 0;
+		}
+	}
+
+	hm->idx++;
+}
+
+/**********************************************************/
+/*
+ * Allocates and initializes a new heatmap with the given number of bytes per
+ * bucket, starting at the given position. If series is non-zero, a data
+ * series is printed instead of a minimap. Returns the new structure, or NULL
+ * if error.
+ */
+heatmap* heatmap_malloc(size_t bucket, size_t start_pos, int series, FILE* fp) {
+	heatmap* hm;
+	size_t i;
+
+	// check parameters
+	if (bucket == 0 || fp == NULL) {
+		return NULL;
+	}
+
+	// allocate memory for structure
+	hm = (heatmap*)malloc(sizeof(heatmap));
+	if (hm == NULL) {
+		return NULL;
+	}
+
+	// set default values
+	hm->fp = fp;
+	hm->bucket = bucket;
+	hm->start_pos = start_pos;
+	hm->idx = 0;
+	hm->total = 0;
+	hm->used = 0;
+	hm->series = series;
+	for (i = 0; i < HEATMAP_ROW; i++) {
+		hm->cnt[i] = 0;
+	}
+
+	return hm;
+}
+
+/**********************************************************/
+/*
+ * Frees the memory used by the given heatmap.
+ */
+void heatmap_free(heatmap* hm) {
+
+	if (hm != NULL) {
+		free(hm);
+	}
+}
+
+/**********************************************************/
+/*
+ * Adds the given number of differing bytes at the given position. Positions
+ * must not decrease between calls, and any buckets before the bucket of the
+ * position are completed and printed. Returns 0 if successful, or -1 if
+ * error.
+ */
+int heatmap_add(heatmap* hm, size_t pos, size_t cnt) {
+	size_t b;
+
+	// check parameters
+	if (hm == NULL || pos < hm->start_pos) {
+		return -1;
+	}
+
+	// complete buckets before the position
+	b = (pos - hm->start_pos) / hm->bucket;
+	while (hm->idx < b) {
+		heatmap_next(hm);
+	}
+
+	hm->cnt[hm->idx % HEATMAP_ROW] += cnt;
+	hm->total += cnt;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Completes all buckets up to the given end position, including a partial
+ * last bucket, and prints a partial last row of the minimap. Returns 0 if
+ * successful, or -1 if error.
+ */
+int heatmap_end(heatmap* hm, size_t pos) {
+	size_t b;
+
+	// check parameters
+	if (hm == NULL) {
+		return -1;
+	}
+
+	// number of buckets, including a partial last bucket
+	b = 0;
+	if (pos > hm->start_pos) {
+		b = ((pos - hm->start_pos) / hm->bucket) + ((pos - hm->start_pos) % hm->bucket > 0 ? 1 : 0);
+	}
+
+	// complete buckets
+	while (hm->idx < b) {
+		heatmap_next(hm);
+	}
+
+	// partial last row
+	if (! hm->series && hm->idx % HEATMAP_ROW > 0) {
+		hm->idx--;
+		heatmap_print_row(hm, (hm->idx % HEATMAP_ROW) + 1);
+		hm->idx++;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Prints the size of the buckets and the scale of the minimap.
+ */
+void heatmap_print_header(heatmap* hm) {
+	fprintf(hm->fp, "heatmap of %zu bytes per bucket, %d buckets per row, scale \"%s\"\n", hm->bucket, HEATMAP_ROW, HEATMAP_SCALE);
+}
+
+/**********************************************************/
+/*
+ * Prints the total number of differing bytes and of buckets with differences.
+ */
+void heatmap_print_footer(heatmap* hm) {
+	fprintf(hm->fp, "%zu differing bytes in %zu of %zu buckets\n", hm->total, hm->used, hm->idx);
+}
+
+/**********************************************************/
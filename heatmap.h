@@ -0,0 +1,28 @@
+#ifndef _HEATMAP_H
+#define _HEATMAP_H
+
+#include <stdio.h>
+
+#define HEATMAP_ROW		64	// buckets per row of the minimap
+
+// density of differing bytes over consecutive buckets
+struct heatmap {
+	FILE* fp;		// output
+	size_t bucket;		// number of bytes per bucket
+	size_t start_pos;	// position of the first bucket
+	size_t idx;		// index of the current bucket
+	size_t cnt[HEATMAP_ROW];	// differing bytes of each bucket in the current row
+	size_t total;		// total differing bytes
+	size_t used;		// number of buckets with differing bytes
+	int series;		// flag to print a data series instead of a minimap
+};
+typedef struct heatmap heatmap;
+
+heatmap* heatmap_malloc(size_t bucket, size_t start_pos, int series, FILE* fp);
+void heatmap_free(heatmap* hm);
+int heatmap_add(heatmap* hm, size_t pos, size_t cnt);
+int heatmap_end(heatmap* hm, size_t pos);
+void heatmap_print_header(heatmap* hm);
+void heatmap_print_footer(heatmap* hm);
+
+#endif /* _HEATMAP_H */
@@ -3,24 +3,39 @@
  */
 
 #include <stdio.h>	// printf(), fileno()
-#include <stdlib.h>	// exit(), strtoull(), malloc(), free()
-#include <string.h>	// strncmp()
+#include <stdlib.h>	// exit(), strtod(), malloc(), free()
+#include <string.h>	// strncmp(), strcmp()
 #include <fcntl.h>	// open()
 #include <sys/stat.h>	// open()
 #include <sys/types.h>	// open()
-#include <sys/time.h>	// struct timeval, gettimeofday()
+#include <sys/time.h>	// struct timeval, gettimeofday(), setitimer()
+#include <signal.h>	// sigaction()
 #include <unistd.h>	// getopt()
+#include "mem.h"
 #include "sbuf.h"
 #include "sbuf_diff.h"
 #include "sbuf_cache.h"
 #include "llq.h"
 #include "llq_num.h"
-
-#define CODE_VERSION		"0.14"
-#define CODE_DATE		"2020-06-18"
+#include "ckpt.h"
+#include "sbuf_pipe.h"
+#include "sbuf_map.h"
+#include "heatmap.h"
+#include "bitflip.h"
+#include "delta.h"
+#include "pool.h"
+#include "range.h"
+#include "sig.h"
+#include "value.h"
+
+#define CODE_VERSION		"0.15"
+#define CODE_DATE		"2026-10-18"
 #define MAX_FILES		4		// maximum files to load
 #define MAX_LENGTH		(size_t)-1	// maximum unsigned length
 #define STD_BUF_SIZE		(size_t)262144
+#define MAX_JOBS		(size_t)1024	// maximum threads to format lines on
+#define BATCH_LINES		(size_t)256	// maximum differing lines per batch
+#define CKPT_INTERVAL		10		// seconds between checkpoints
 
 // configurable bitwise flags
 #define FLAG_COLOR		1		// enable ANSI color
@@ -33,6 +48,25 @@
 #define FLAG_DISP_DIFF		256		// display differences
 #define FLAG_NULL_BYTES_DIFF	512		// NULLs bytes are different
 #define FLAG_UPPER_HEX		1024		// uppercase hexadecimal
+#define FLAG_RESUME		2048		// resume from checkpoint
+#define FLAG_PROGRESS		4096		// report progress
+#define FLAG_THREADS		8192		// read, compare and print on separate threads
+#define FLAG_DIRECT		16384		// direct I/O, bypassing the page cache
+#define FLAG_DROP		32768		// drop pages from the page cache once read
+#define FLAG_HEATMAP		65536		// print a heatmap instead of lines
+#define FLAG_BITFLIP		131072		// print bit-flip statistics instead of lines
+#define FLAG_DELTA		262144		// print difference statistics instead of lines
+#define FLAG_LITTLE_ENDIAN	524288		// words of -h are little-endian
+#define FLAG_REPEAT		1048576		// collapse repeated lines
+#define FLAG_PARALLEL		2097152		// format lines on multiple threads
+#define FLAG_MASK		4194304		// compare only the bits of a mask
+#define FLAG_TOLERANCE		8388608		// compare values within a tolerance
+#define FLAG_SIGN		16777216	// generate a signature of blocks
+#define FLAG_VERIFY		33554432	// verify against a signature of blocks
+#define FLAG_SIG_BLOCK		67108864	// block size of signatures was given
+
+// flags changing the output, which must match to resume from a checkpoint
+#define FLAG_OUTPUT		(FLAG_COLOR | FLAG_HEX | FLAG_ASCII | FLAG_VERBOSE | FLAG_QUIET1 | FLAG_QUIET2 | FLAG_DISP_DIFF | FLAG_NULL_BYTES_DIFF | FLAG_UPPER_HEX | FLAG_LITTLE_ENDIAN | FLAG_MASK | FLAG_TOLERANCE)
 
 // empty spaces
 // can change to literal spaces
@@ -67,6 +101,24 @@
 #define COLOR_ASCII_HL		"\x1b[1;41;33m"
 #endif
 
+// lines of a batch formatted in parallel
+struct render {
+	sbuf** sb;		// buffer of each file
+	int sb_cnt;		// number of files
+	int* f_excl;		// flag to exclude each file
+	sbuf_diff_batch* batch;	// differences of the lines
+	sbuf_diff* empty;	// difference structure of lines without differences
+	size_t pos;		// position of the first line
+	size_t lines;		// number of lines to print
+	size_t width;		// number of bytes per line per file
+	size_t end_pos;		// ending position of output
+	int flags;		// configurable bitwise flags
+	FILE** out;		// output of each part
+	char** buf;		// buffer of the output of each part
+	size_t* len;		// length of the output of each part
+};
+typedef struct render render;
+
 /**********************************************************/
 /*
  * Prints a usage statement to STDERR.
@@ -75,8 +127,11 @@ void usage(char* program, char* error) {
 	fprintf(stderr, "hexdiff %s released %s\n", CODE_VERSION, CODE_DATE);
 	fprintf(stderr, "Usage: %s [options] FILE [...]\n", program);
 	fprintf(stderr, "Display hexadecimal differences between files.\n");
+	fprintf(stderr, "FILE is - for STDIN, or %sHEX for a virtual file repeating the given bytes.\n", SFILE_PATTERN);
+	fprintf(stderr, "FILE%cOFFSET%cLENGTH is a region of FILE, up to its end if LENGTH is not given.\n", SFILE_MAP_AT, SFILE_MAP_LEN);
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "    -v         : verbose, display all lines\n");
+	fprintf(stderr, "    -r         : collapse lines repeating the previous line of -v or a single file into *\n");
 	fprintf(stderr, "    -q         : quiet, do not display file names, spacers, bytes, bars\n");
 	fprintf(stderr, "    -Q         : quiet, do not display position\n");
 	fprintf(stderr, "    -n         : disable ANSI color\n");
@@ -88,13 +143,34 @@ void usage(char* program, char* error) {
 	fprintf(stderr, "    -u         : display hexadecimal in uppercase\n");
 	fprintf(stderr, "    -p offset  : sets the display offset position (default is 0)\n");
 	fprintf(stderr, "    -l length  : sets the maximum length to display (default is until EOF)\n");
+	fprintf(stderr, "    -L ranges  : compares only the given offset:length ranges, listed or in @file\n");
 	fprintf(stderr, "    -w width   : sets the number of bytes per line (default is 16)\n");
 	fprintf(stderr, "    -h width   : sets the number of differing bytes to highlight (default is 1)\n");
+	fprintf(stderr, "    -e         : words of -h are little-endian (default is big-endian)\n");
+	fprintf(stderr, "    -a mask    : compares only the bits of each word of -h set in mask (default is all)\n");
+	fprintf(stderr, "    -f tol     : words of -h within tol, given as TYPE:EPS[r] of type u, i or f, are equal (default is exact)\n");
 	fprintf(stderr, "    -c context : sets the number of lines of context (default is 0)\n");
 	fprintf(stderr, "    -s #:seek  : seeks to offset position of file # (starting at 0)\n");
 	fprintf(stderr, "    -S #:shift : shifts starting offset position for file # (starting at 0)\n");
 	fprintf(stderr, "    -X #       : excludes output for file # (starting at 0)\n");
 	fprintf(stderr, "    -I diff    : ignore the given difference, based on -h (default is none)\n");
+	fprintf(stderr, "    -m lines   : stop after the given number of differing lines (default is no limit)\n");
+	fprintf(stderr, "    -M bytes   : stop after the given number of differing bytes (default is no limit)\n");
+	fprintf(stderr, "    -C file    : periodically save a checkpoint to the given file\n");
+	fprintf(stderr, "    -R         : resume from the checkpoint given by -C\n");
+	fprintf(stderr, "    -P secs    : report progress to STDERR every secs seconds and on SIGUSR1 (0 is SIGUSR1 only)\n");
+	fprintf(stderr, "    -T         : read, compare and print on separate threads\n");
+	fprintf(stderr, "    -j threads : format lines of -v or a single file on the given number of threads\n");
+	fprintf(stderr, "    -D         : use direct I/O, bypassing the page cache\n");
+	fprintf(stderr, "    -E         : drop pages from the page cache once read\n");
+	fprintf(stderr, "    -G bucket  : print a heatmap of differing bytes per bucket instead of lines\n");
+	fprintf(stderr, "    -B         : print bit-flip statistics of words, based on -h, instead of lines\n");
+	fprintf(stderr, "    -k top     : print the top most frequent and largest differences, based on -h, instead of lines\n");
+	fprintf(stderr, "    -g file    : generates a signature of the hashes of each block of a single FILE\n");
+	fprintf(stderr, "    -V file    : verifies the last FILE against a signature, displaying differing blocks against the first if given\n");
+	fprintf(stderr, "    -W block   : sets the block size of generated signatures (default is ");
+	fprintf(stderr, "%zu", SIG_BLOCK_SIZE);
+	fprintf(stderr, ")\n");
 	fprintf(stderr, "    -b size    : sets the I/O buffer size (default is ");
 	fprintf(stderr, "%zu", STD_BUF_SIZE);
 	fprintf(stderr, ")\n");
@@ -108,20 +184,16 @@ void usage(char* program, char* error) {
 /**********************************************************/
 /*
  * Parses a string and returns the numerical representation as an unsigned
- * value. Supports both decimal and hexadecimal values.
+ * value. Supports both decimal and hexadecimal values, and returns 0 if the
+ * string is not a value, including a negative value.
  */
 size_t parse_value(const char* str) {
 	size_t offset;
+	char* end;
 
-	if (str == NULL) {
+	if (str == NULL || value_parse((char*)str, &end, &offset) < 0) {
 		offset = 0;
 	}
-	else if (strncmp(str, "0x", 2) == 0) {
-		offset = strtoull(str + 2, 0, 16);
-	}
-	else {
-		offset = strtoull(str, 0, 10);
-	}
 
 	return offset;
 }
@@ -135,6 +207,66 @@ double time_elapsed(struct timeval t1, struct timeval t0) {
 	return (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1000000.0f;
 }
 
+/**********************************************************/
+/*
+ * Flag set by signal handlers to request a progress report. It is only checked
+ * between groups of lines, so a report costs nothing per line.
+ */
+volatile sig_atomic_t progress_requested = 0;
+
+/*
+ * Signal handler for SIGALRM and SIGUSR1 to request a progress report.
+ */
+void progress_signal(int sig) {
+	progress_requested = 1;
+}
+
+/**********************************************************/
+/*
+ * Prints a progress report to STDERR. Includes the current position against
+ * the end position (if known), the read throughput of each file and the
+ * number of lines with differences so far. The throughput and estimated time
+ * remaining are calculated from the given position and byte deltas over the
+ * given number of seconds. Always returns 0.
+ */
+int print_progress(size_t pos, size_t end, size_t diff_lines, double secs, size_t pos_delta, char** filename, size_t* bytes_delta, int file_cnt) {
+	int i;
+	double eta;
+
+	// avoid division by zero
+	if (secs <= 0) {
+		secs = 0.000001;
+	}
+
+	// position
+	fprintf(stderr, "progress: %08zx", pos);
+	if (end != MAX_LENGTH && end > 0) {
+		fprintf(stderr, " of %08zx (%.1f%%)", end, 100.0 * pos / end);
+	}
+
+	// throughput of each file
+	for (i = 0; i < file_cnt; i++) {
+		fprintf(stderr, ", %s %.1f MB/s", filename[i], bytes_delta[i] / secs / 1000000.0);
+	}
+
+	// lines with differences
+	fprintf(stderr, ", %zu lines differ", diff_lines);
+
+	// estimated time remaining
+	if (end != MAX_LENGTH && end > pos && pos_delta > 0) {
+		eta = (end - pos) / (pos_delta / secs);
+		fprintf(stderr, ", ETA %02d:%02d:%02d",
+			(int)(eta / 3600),
+			(int)(eta / 60) % 60,
+			(int)eta % 60
+		);
+	}
+
+	fprintf(stderr, "\n");
+
+	return 0;
+}
+
 /**********************************************************/
 /*
  * Returns the number of spaces associated with each line of a file on the
@@ -176,8 +308,8 @@ int wspaces(size_t width, int flags) {
 /*
  * Prints a new line. Always returns 0.
  */
-int print_nl(int flags) {
-	printf("\n");
+int print_nl(FILE* fp, int flags) {
+	fprintf(fp, "\n");
 	return 0;
 }
 
@@ -186,7 +318,7 @@ int print_nl(int flags) {
  * Prints a position. If the COLOR flag is set, ANSI color codes will be
  * printed. Always returns 0.
  */
-int print_pos(size_t pos, int flags) {
+int print_pos(FILE* fp, size_t pos, int flags) {
 
 	if (flags & FLAG_QUIET2) {
 		return 0;
@@ -194,21 +326,21 @@ int print_pos(size_t pos, int flags) {
 
 	// print value in hex
 	if (flags & FLAG_COLOR) {
-		printf(COLOR_POS);
+		fprintf(fp, COLOR_POS);
 		if (flags & FLAG_UPPER_HEX) {
-			printf("%08zX", pos);
+			fprintf(fp, "%08zX", pos);
 		}
 		else {
-			printf("%08zx", pos);
+			fprintf(fp, "%08zx", pos);
 		}
-		printf(COLOR_RESET);
+		fprintf(fp, COLOR_RESET);
 	}
 	else {
 		if (flags & FLAG_UPPER_HEX) {
-			printf("%08zX", pos);
+			fprintf(fp, "%08zX", pos);
 		}
 		else {
-			printf("%08zx", pos);
+			fprintf(fp, "%08zx", pos);
 		}
 	}
 
@@ -221,7 +353,7 @@ int print_pos(size_t pos, int flags) {
  * number of spaces to print for positions larger than 32 bits, otherwise
  * prints 8 spaces. Always returns 0.
  */
-int print_empty_pos(size_t pos, int flags) {
+int print_empty_pos(FILE* fp, size_t pos, int flags) {
 	unsigned char ch_len;
 
 	if (flags & FLAG_QUIET2) {
@@ -248,7 +380,7 @@ int print_empty_pos(size_t pos, int flags) {
 	}
 
 	// print determined number of spaces
-	printf("%*s", ch_len, "");
+	fprintf(fp, "%*s", ch_len, "");
 
 	return 0;
 }
@@ -259,26 +391,26 @@ int print_empty_pos(size_t pos, int flags) {
  * string is longer than span, it will be truncated. If the COLOR flag is set,
  * ANSI color codes will be printed. Always returns 0;
  */
-int print_string(char* str, int span, int flags) {
+int print_string(FILE* fp, char* str, int span, int flags) {
 
 	// extra space
 	if (! (flags & FLAG_QUIET1)) {
-		printf(" ");
+		fprintf(fp, " ");
 	}
 
 	// NULL string, print spaces only
 	if (str == NULL) {
-		printf(" %*s", span, "");
+		fprintf(fp, " %*s", span, "");
 		return 0;
 	}
 
 	// print as a string
 	if (flags & FLAG_COLOR) {
-		printf(COLOR_STRING);
+		fprintf(fp, COLOR_STRING);
 	}
-	printf(" %-*.*s", span, span, str);
+	fprintf(fp, " %-*.*s", span, span, str);
 	if (flags & FLAG_COLOR) {
-		printf(COLOR_RESET);
+		fprintf(fp, COLOR_RESET);
 	}
 
 	return 0;
@@ -290,7 +422,7 @@ int print_string(char* str, int span, int flags) {
  * resulting string is longer than span, it will be truncated. If the COLOR
  * flag is set, ANSI color codes will be printed. Always returns 0.
  */
-int print_bytes(size_t num, int span, int flags) {
+int print_bytes(FILE* fp, size_t num, int span, int flags) {
 	char* buf;
 
 	// allocate memory for temporary string
@@ -298,13 +430,13 @@ int print_bytes(size_t num, int span, int flags) {
 
 	// could not allocate memory, print spaces instead
 	if (buf == NULL) {
-		printf(" %*s", span, "");
+		fprintf(fp, " %*s", span, "");
 		return 0;
 	}
 
 	// print as a string
 	snprintf(buf, span + 1, "%zu bytes", num);
-	print_string(buf, span, flags);
+	print_string(fp, buf, span, flags);
 
 	// free allocated memory
 	free(buf);
@@ -318,17 +450,17 @@ int print_bytes(size_t num, int span, int flags) {
  * contain any differences. If the COLOR flag is set, ANSI color codes will be
  * printed. Always returns 0.
  */
-int print_spacer(int flags) {
+int print_spacer(FILE* fp, int flags) {
 
 	if (! (flags & FLAG_QUIET1)) {
 		if (flags & FLAG_COLOR) {
-			printf(COLOR_SPACER);
+			fprintf(fp, COLOR_SPACER);
 		}
-		printf("*");
+		fprintf(fp, "*");
 		if (flags & FLAG_COLOR) {
-			printf(COLOR_RESET);
+			fprintf(fp, COLOR_RESET);
 		}
-		print_nl(flags);
+		print_nl(fp, flags);
 	}
 
 	return 0;
@@ -346,10 +478,11 @@ int print_spacer(int flags) {
  * end-of-output, len should be set to zero to print NULL bytes for the entire
  * line. Always returns 0.
  */
-int print_buf(unsigned char* buf, size_t len, size_t before, size_t width, sbuf_diff* d, int flags) {
+int print_buf(FILE* fp, unsigned char* buf, size_t len, size_t before, size_t width, sbuf_diff* d, int flags) {
 	size_t i;
 	unsigned char ch;
 	int hl;
+	size_t hl_next;		// next byte to highlight
 
 	// NOTE: buf can be NULL to print empty space
 	if (buf == NULL) {
@@ -358,93 +491,96 @@ int print_buf(unsigned char* buf, size_t len, size_t before, size_t width, sbuf_
 
 	// extra space
 	if (! (flags & FLAG_QUIET1)) {
-		printf(" ");
+		fprintf(fp, " ");
 	}
 
 	// print hex
 	if (flags & FLAG_HEX) {
 
-		printf(" ");
+		fprintf(fp, " ");
 
 		if (flags & FLAG_COLOR) {
-			printf(COLOR_HEX);
+			fprintf(fp, COLOR_HEX);
 		}
+		hl_next = sbuf_diff_next(d, 0);
 		for (i = 0; i < width; i++) {
 
 			// separate hex groups
 			if (i > 0 && i % 4 == 0) {
-				printf(" ");
+				fprintf(fp, " ");
 			}
 
 			if (i < before) {
-				printf(EMPTY_HEX);
+				fprintf(fp, EMPTY_HEX);
 			}
 			else if (i >= len + before) {
-				printf(EMPTY_HEX);
+				fprintf(fp, EMPTY_HEX);
 			}
 			else {
 				ch = buf[i - before];
 
 				// mark for highlight
-				hl = 0;
-				if (d != NULL && d->cmp[i]) {
-					hl = 1;
+				// skips highlights of NULL bytes
+				if (hl_next < i) {
+					hl_next = sbuf_diff_next(d, i);
 				}
+				hl = (i == hl_next);
 
 				// print hex character
 				if (flags & FLAG_COLOR && hl) {
-					printf(COLOR_HEX_HL);
+					fprintf(fp, COLOR_HEX_HL);
 					if (flags & FLAG_UPPER_HEX) {
-						printf("%02X", ch);
+						fprintf(fp, "%02X", ch);
 					}
 					else {
-						printf("%02x", ch);
+						fprintf(fp, "%02x", ch);
 					}
-					printf(COLOR_HEX);
+					fprintf(fp, COLOR_HEX);
 				}
 				else {
 					if (flags & FLAG_UPPER_HEX) {
-						printf("%02X", ch);
+						fprintf(fp, "%02X", ch);
 					}
 					else {
-						printf("%02x", ch);
+						fprintf(fp, "%02x", ch);
 					}
 				}
 			}
 		}
 		if (flags & FLAG_COLOR) {
-			printf(COLOR_RESET);
+			fprintf(fp, COLOR_RESET);
 		}
 	}
 
 	// print ascii
 	if (flags & FLAG_ASCII) {
 
-		printf(" ");
+		fprintf(fp, " ");
 
 		// print bar
 		if (! (flags & FLAG_QUIET1)) {
 			if (flags & FLAG_COLOR) {
-				printf(COLOR_BAR);
+				fprintf(fp, COLOR_BAR);
 			}
 			if (len == 0 || before >= width) {
-				printf(EMPTY_BAR);
+				fprintf(fp, EMPTY_BAR);
 			}
 			else {
-				printf("|");
+				fprintf(fp, "|");
 			}
 		}
 
 		// print ascii
 		if (flags & FLAG_COLOR) {
-			printf(COLOR_ASCII);
+			fprintf(fp, COLOR_ASCII);
 		}
+		hl_next = sbuf_diff_next(d, 0);
 		for (i = 0; i < width; i++) {
 			if (i < before) {
-				printf(EMPTY_ASCII);
+				fprintf(fp, EMPTY_ASCII);
 			}
 			else if (i >= len + before) {
-				printf(EMPTY_ASCII);
+				fprintf(fp, EMPTY_ASCII);
 			}
 			else {
 				ch = buf[i - before];
@@ -455,19 +591,20 @@ int print_buf(unsigned char* buf, size_t len, size_t before, size_t width, sbuf_
 				}
 
 				// mark for highlight
-				hl = 0;
-				if (d != NULL && d->cmp[i]) {
-					hl = 1;
+				// skips highlights of NULL bytes
+				if (hl_next < i) {
+					hl_next = sbuf_diff_next(d, i);
 				}
+				hl = (i == hl_next);
 
 				// print ascii character
 				if (flags & FLAG_COLOR && hl) {
-					printf(COLOR_ASCII_HL);
-					printf("%c", ch);
-					printf(COLOR_ASCII);
+					fprintf(fp, COLOR_ASCII_HL);
+					fprintf(fp, "%c", ch);
+					fprintf(fp, COLOR_ASCII);
 				}
 				else {
-					printf("%c", ch);
+					fprintf(fp, "%c", ch);
 				}
 			}
 		}
@@ -475,19 +612,19 @@ int print_buf(unsigned char* buf, size_t len, size_t before, size_t width, sbuf_
 		// print bar
 		if (! (flags & FLAG_QUIET1)) {
 			if (flags & FLAG_COLOR) {
-				printf(COLOR_BAR);
+				fprintf(fp, COLOR_BAR);
 			}
 			if (len == 0 || before >= width) {
-				printf(EMPTY_BAR);
+				fprintf(fp, EMPTY_BAR);
 			}
 			else {
-				printf("|");
+				fprintf(fp, "|");
 			}
 		}
 	}
 
 	if (flags & FLAG_COLOR) {
-		printf(COLOR_RESET);
+		fprintf(fp, COLOR_RESET);
 	}
 
 	return 0;
@@ -502,14 +639,14 @@ int print_buf(unsigned char* buf, size_t len, size_t before, size_t width, sbuf_
  * option. The difference struct and flags are passed on to print_buf(). Always
  * returns 0.
  */
-int print_sbuf(sbuf* sb, size_t pos, size_t width, size_t mlw, sbuf_diff* d, int flags) {
+int print_sbuf(FILE* fp, sbuf* sb, size_t pos, size_t width, size_t mlw, sbuf_diff* d, int flags) {
 	unsigned char* ptr;
 	size_t btp;
 	size_t before;
 
 	// print a lines of NULLs for a NULL buffer
 	if (sb == NULL) {
-		print_buf(NULL, 0, 0, width, d, flags);
+		print_buf(fp, NULL, 0, 0, width, d, flags);
 		return 0;
 	}
 
@@ -531,7 +668,7 @@ int print_sbuf(sbuf* sb, size_t pos, size_t width, size_t mlw, sbuf_diff* d, int
 	}
 
 	// print buffer
-	print_buf(ptr, btp, before, width, d, flags);
+	print_buf(fp, ptr, btp, before, width, d, flags);
 
 	return 0;
 };
@@ -545,7 +682,7 @@ int print_sbuf(sbuf* sb, size_t pos, size_t width, size_t mlw, sbuf_diff* d, int
  * user provided option. The difference structure itself is NOT passed on to
  * print_buf() (it should not be highlighted), but the flags are passed on.
  */
-int print_diff(sbuf_diff* d, size_t pos, size_t width, size_t mlw, int flags) {
+int print_diff(FILE* fp, sbuf_diff* d, size_t pos, size_t width, size_t mlw, int flags) {
 	unsigned char* ptr;
 	size_t btp;
 	size_t i;
@@ -554,12 +691,12 @@ int print_diff(sbuf_diff* d, size_t pos, size_t width, size_t mlw, int flags) {
 
 	// print a line of NULLs for a NULL buffer
 	if (d == NULL) {
-		print_buf(NULL, 0, 0, width, NULL, flags);
+		print_buf(fp, NULL, 0, 0, width, NULL, flags);
 		return 0;
 	}
 	sb = d->sub;
 	if (sb == NULL) {
-		print_buf(NULL, 0, 0, width, NULL, flags);
+		print_buf(fp, NULL, 0, 0, width, NULL, flags);
 		return 0;
 	}
 
@@ -579,14 +716,14 @@ int print_diff(sbuf_diff* d, size_t pos, size_t width, size_t mlw, int flags) {
 	for (i = 0; i < width; i++) {
 
 		// NULL bytes and difference of 0
-		if (d->null->ptr[i] > 0 && d->sub->ptr[i] == 0) {
+		if (SBUF_DIFF_BIT(d->null, i) && d->sub->ptr[i] == 0) {
 			before++;
 			ptr += 1;
 			btp -= 1;
 		}
 
 		// non-differing bytes (before only)
-		else if (d->cmp[i] == 0) {
+		else if (! SBUF_DIFF_BIT(d->cmp, i)) {
 			before++;
 			ptr += 1;
 			btp -= 1;
@@ -601,12 +738,12 @@ int print_diff(sbuf_diff* d, size_t pos, size_t width, size_t mlw, int flags) {
 	for (i = width - 1; 0 <= i && i <= width && btp > 0; i--) {
 
 		// NULL bytes and difference of 0
-		if (d->null->ptr[i] > 0 && d->sub->ptr[i] == 0) {
+		if (SBUF_DIFF_BIT(d->null, i) && d->sub->ptr[i] == 0) {
 			btp -= 1;
 		}
 
 		// non-differing bytes (after only)
-		else if (d->cmp[i] == 0) {
+		else if (! SBUF_DIFF_BIT(d->cmp, i)) {
 			btp -= 1;
 		}
 
@@ -616,11 +753,230 @@ int print_diff(sbuf_diff* d, size_t pos, size_t width, size_t mlw, int flags) {
 	}
 
 	// do NOT highlight differences, pass NULL instead of d
-	print_buf(ptr, btp, before, width, NULL, flags);
+	print_buf(fp, ptr, btp, before, width, NULL, flags);
 
 	return 0;
 };
 
+/**********************************************************/
+/*
+ * Prints the line at the given position of all given buffers which are not
+ * excluded, starting with the position and ending with the subtraction
+ * differences if enabled and if the line has at least one difference or the
+ * verbose flag is set. The maximum line width, difference structure and flags
+ * are passed on to print_sbuf() and print_diff(). Always returns 0.
+ */
+int print_files(FILE* fp, sbuf** sb, int sb_cnt, int* f_excl, size_t pos, size_t width, size_t mlw, sbuf_diff* d, int flags) {
+	int i;
+
+	// print position
+	print_pos(fp, pos, flags);
+
+	// loop through files
+	for (i = 0; i < sb_cnt; i++) {
+
+		if (! f_excl[i]) {
+			// print current line of file
+			print_sbuf(
+				fp,
+				sb[i],
+				pos,
+				width,
+				mlw,
+				d,
+				flags
+			);
+		}
+	}
+
+	// print subtraction differences last
+	// only print if there is at least one difference
+	// or if the verbose flag is set
+	if (flags & FLAG_DISP_DIFF && ((d->cnt > 0) || (flags & FLAG_VERBOSE))) {
+
+		// print differences
+		print_diff(
+			fp,
+			d,
+			pos,
+			width,
+			mlw,
+			flags
+		);
+	}
+
+	// print newline
+	print_nl(fp, flags);
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Prints the header of the output, the name of each file which is not
+ * excluded, with spaces in place of the position. Always returns 0.
+ */
+int print_header(FILE* fp, char** filename, int file_cnt, int* f_excl, size_t pos, size_t width, int flags) {
+	int i;
+
+	// print spaces in place of position
+	print_empty_pos(fp, pos, flags);
+
+	// loop through files
+	for (i = 0; i < file_cnt; i++) {
+
+		if (! f_excl[i]) {
+			// print file name
+			print_string(
+				fp,
+				filename[i],
+				wspaces(width, flags),
+				flags
+			);
+		}
+	}
+
+	fprintf(fp, "\n");
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Prints the footer of the output, the number of bytes of each file which is
+ * not excluded up to the end position, with spaces in place of the last
+ * position. Always returns 0.
+ */
+int print_footer(FILE* fp, sfile** sf, int file_cnt, int* f_excl, size_t pos, size_t end_pos, size_t width, int flags) {
+	size_t tmp;
+	int i;
+
+	// print spaces in place of last position
+	if (pos >= width) {
+		print_empty_pos(fp, pos - width, flags);
+	}
+	else {
+		print_empty_pos(fp, 0, flags);
+	}
+
+	// loop through files
+	for (i = 0; i < file_cnt; i++) {
+
+		if (! f_excl[i]) {
+
+			// output was truncated
+			if (end_pos > sf[i]->start_pos) {
+				tmp = end_pos - sf[i]->start_pos;
+			}
+			// entire buffer was NULL bytes at beginning
+			else {
+				tmp = 0;
+			}
+			// use all bytes read if before end_pos
+			if (sf[i]->bytes_read < tmp) {
+				tmp = sf[i]->bytes_read;
+			}
+
+			// print number of bytes per file
+			print_bytes(fp, tmp, wspaces(width, flags), flags);
+		}
+	}
+
+	fprintf(fp, "\n");
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Seeks each file to the given starting position plus its seek position, and
+ * sets the position of its buffer to the starting position. If the shift of a
+ * file negates this position, the file is shifted instead, starting with NULL
+ * bytes. Used for the first range and to move to each following range, after
+ * which files that cannot be seeked only move forward. Nothing is read ahead
+ * past the end position, unless it is the maximum length.
+ */
+void seek_files(sfile** sf, sbuf** sb, int file_cnt, size_t start_pos, size_t end_pos, size_t* seek, size_t* shift) {
+	size_t tmp;
+	int i;
+
+	for (i = 0; i < file_cnt; i++) {
+
+		// temporary seek position
+		tmp = start_pos + seek[i];
+
+		// file offset of the end position
+		sf[i]->stop = 0;
+		if (end_pos != MAX_LENGTH && end_pos + seek[i] >= end_pos && tmp + (end_pos - start_pos) > shift[i]) {
+			sf[i]->stop = tmp + (end_pos - start_pos) - shift[i];
+		}
+
+		// position is not negated by shift
+		if (tmp > shift[i]) {
+
+			// seek
+			sfile_move(sf[i], sb[i], tmp - shift[i]);
+
+			// set new position
+			sb[i]->pos = start_pos;
+			sf[i]->start_pos = start_pos;
+		}
+		else {
+
+			// shift from the start of the file
+			sfile_move(sf[i], sb[i], 0);
+			sb[i]->pos = 0;
+			sfile_shift(sf[i], sb[i], shift[i]);
+		}
+	}
+}
+
+/**********************************************************/
+/*
+ * Prints the part of the given lines with the given index into the output of
+ * that part, for each part of a pool formatting lines in parallel. The lines
+ * are split in contiguous parts of about the same number of lines.
+ */
+void render_part(void* arg, int idx, int cnt) {
+	render* r = (render*)arg;
+	size_t line;
+	size_t last;
+	size_t pos;
+	size_t mlw;
+	size_t k;
+	sbuf_diff* d;
+
+	// lines of this part
+	line = (r->lines * idx) / cnt;
+	last = (r->lines * (idx + 1)) / cnt;
+
+	// first differing line of this part
+	k = 0;
+	while (k < r->batch->cnt && r->batch->idx[k] < line) {
+		k++;
+	}
+
+	for (; line < last; line++) {
+
+		// calculate maximum width of this line according to length
+		pos = r->pos + (line * r->width);
+		mlw = r->width;
+		if (pos < r->end_pos && r->end_pos < (pos + r->width)) {
+			mlw = r->end_pos - pos;
+		}
+
+		// use empty difference structure unless line differs
+		d = r->empty;
+		if (k < r->batch->cnt && r->batch->idx[k] == line) {
+			d = r->batch->diff[k];
+			k++;
+		}
+
+		// print into the output of this part
+		print_files(r->out[idx], r->sb, r->sb_cnt, r->f_excl, pos, r->width, mlw, d, r->flags);
+	}
+}
+
 /**********************************************************/
 /*
  * Adds the given buffer to the given cache at the given position. The buffer
@@ -690,6 +1046,66 @@ int cache_add(sbuf* sb, sbuf_cache* c, size_t pos, size_t max_lines) {
 	return removed;
 }
 
+/**********************************************************/
+/*
+ * Returns 1 if the line of each of the given buffers at the given position is
+ * the same as the previous line, or 0 if not. Only whole lines of width bytes
+ * are compared, where each buffer either holds the entire line or none of it.
+ * The previous line of each buffer is kept in prev, with its length in
+ * prev_len ((size_t)-1 if the line cannot be repeated), and is replaced by the
+ * given line if it differs.
+ */
+int line_repeat(sbuf** sb, int sb_cnt, size_t pos, size_t width, size_t mlw, unsigned char* prev, size_t* prev_len) {
+	int i;
+	int same;
+	size_t len[MAX_FILES];
+
+	// compare each buffer to its previous line
+	same = 1;
+	for (i = 0; i < sb_cnt; i++) {
+
+		// entire line
+		if (sbuf_before(sb[i], pos) == 0 && sbuf_avail(sb[i], pos) >= width) {
+			len[i] = width;
+		}
+
+		// line of NULL bytes only
+		else if (sbuf_avail(sb[i], pos) == 0 || sbuf_before(sb[i], pos) >= width) {
+			len[i] = 0;
+		}
+
+		// partial line
+		else {
+			len[i] = (size_t)-1;
+		}
+
+		// last line of output is never repeated
+		if (mlw < width) {
+			len[i] = (size_t)-1;
+		}
+
+		// differs from previous line
+		if (len[i] != prev_len[i] || len[i] == (size_t)-1) {
+			same = 0;
+		}
+		else if (len[i] > 0 && memcmp(prev + (i * width), sbuf_ptr(sb[i], pos), width) != 0) {
+			same = 0;
+		}
+	}
+
+	// keep line for the next comparison
+	if (! same) {
+		for (i = 0; i < sb_cnt; i++) {
+			prev_len[i] = len[i];
+			if (len[i] == width) {
+				memcpy(prev + (i * width), sbuf_ptr(sb[i], pos), width);
+			}
+		}
+	}
+
+	return same;
+}
+
 /**********************************************************/
 
 int main(int argc, char* argv[]) {
@@ -701,8 +1117,26 @@ int main(int argc, char* argv[]) {
 	sbuf* sb[MAX_FILES];
 	sbuf_cache* cache[MAX_FILES];
 	int f_excl[MAX_FILES];
+	mem_arena* arena = NULL;
+	range_list* ranges = NULL;
 	llq_list* ignore = NULL;
+	char* ckpt_path = NULL;
+	char* sig_path = NULL;
+	sig* sg = NULL;
+	pool* hashers = NULL;
+	char* end;
+	ckpt* ck = NULL;
 	sbuf_diff* diff;
+	sbuf_diff_batch* batch;
+	sbuf_diff_word word;
+	sbuf_pipe* pipeline = NULL;
+	heatmap* heat = NULL;
+	bitflip* flip = NULL;
+	delta* dt = NULL;
+	unsigned char* prev_line = NULL;
+	pool* workers = NULL;
+	render rd;
+	size_t prev_len[MAX_FILES];
 
 	// configurable variables
 	size_t width = 16;
@@ -710,30 +1144,60 @@ int main(int argc, char* argv[]) {
 	size_t len = MAX_LENGTH;
 	size_t end_pos = MAX_LENGTH;
 	size_t hl_width = 1;
+	size_t mask = 0;
+	int tol_type = 0;
+	double tol_eps = 0;
+	int tol_rel = 0;
 	size_t context = 0;
 	size_t buf_size = STD_BUF_SIZE;
+	size_t max_diff_lines = MAX_LENGTH;
+	size_t max_diff_bytes = MAX_LENGTH;
+	size_t progress = 0;
+	size_t heat_size = 0;
+	size_t delta_top = 0;
+	size_t sig_block = SIG_BLOCK_SIZE;
+	size_t jobs = 0;
 	size_t seek[MAX_FILES];
 	size_t shift[MAX_FILES];
 	int flags = FLAG_COLOR | FLAG_HEX | FLAG_ASCII;
 
 	// time variables
 	struct timeval ts_start, ts_end;
+	struct timeval ts_ckpt, ts_now;
+	struct timeval ts_prog;
+	struct stat st;
+	struct sigaction sa;
+	struct itimerval it;
 
 	// tracking variables
 	size_t context_after = MAX_LENGTH;
 	int spacer_printed = 0;
+	size_t diff_lines = 0;	// number of lines with differences
+	size_t diff_bytes = 0;	// number of differing bytes
+	size_t range_idx = 0;	// index of the current range of -L
+	size_t prog_end;	// end position for progress, if known
+	size_t prog_pos;	// position at last progress report
+	size_t prog_bytes[MAX_FILES];	// bytes read at last progress report
 
 	// temporary variables
 	int i;
-	int j;
 	char opt;
 	size_t tmp;
+	off_t size;		// size of file
 	int loop;
 	size_t pos;		// current position
-	ssize_t br;		// bytes read (signed)
 	size_t mlw;		// maximum line width
-	int eoo_cnt;		// end-of-output count
 	int print_line;		// boolean flag to print the current line
+	int repeat;		// boolean flag for a line repeating the previous line
+	int ret = EXIT_SUCCESS;	// exit status, failure if any file could not be closed
+	size_t lines;		// number of lines compared at once
+	size_t line;		// current line of compared lines
+	size_t k;		// index of next differing line
+	size_t run;		// number of lines without differences
+	sbuf_diff* d;		// difference structure of current line
+	sbuf_pipe_batch* pb;	// batch of compared lines
+	sbuf** wsb;		// buffers of the compared lines
+	sfile* wsf;		// state of files at the end of the buffers
 
 	sbuf* tmp_sb;		// temporary sbuf for cache printing
 	size_t tmp_pos;		// temporary position for cache printing
@@ -742,6 +1206,8 @@ int main(int argc, char* argv[]) {
 
 	// elapsed time
 	gettimeofday(&ts_start, NULL);
+	ts_ckpt = ts_start;
+	ts_prog = ts_start;
 
 	/******************************/
 
@@ -767,7 +1233,7 @@ int main(int argc, char* argv[]) {
 
 	// command line options
 	opterr = 0;
-	while ((opt = getopt(argc, argv, "vqQndHANtup:l:w:h:c:s:S:X:I:b:")) != -1) {
+	while ((opt = getopt(argc, argv, "vrqQndHANtup:l:L:w:h:ea:f:c:s:S:X:I:m:M:C:RP:Tj:DEG:Bk:g:V:W:b:")) != -1) {
 		switch(opt) {
 
 			// verbose, display all lines
@@ -780,6 +1246,11 @@ int main(int argc, char* argv[]) {
 				flags |= FLAG_QUIET1;
 				break;
 
+			// collapse repeated lines
+			case 'r':
+				flags |= FLAG_REPEAT;
+				break;
+
 			// extra quiet, do not display position
 			case 'Q':
 				flags |= FLAG_QUIET2;
@@ -830,6 +1301,24 @@ int main(int argc, char* argv[]) {
 				len = parse_value(optarg);
 				break;
 
+			// ranges, listed or in a file given as @file
+			case 'L':
+				if (ranges == NULL) {
+					ranges = range_malloc();
+					if (ranges == NULL) {
+						usage(argv[0], "Could not allocate ranges.");
+					}
+				}
+				if (optarg[0] == RANGE_FILE) {
+					if (range_read(ranges, optarg + 1) != 0) {
+						usage(argv[0], "Could not read ranges file.");
+					}
+				}
+				else if (range_parse(ranges, optarg) != 0) {
+					usage(argv[0], "Illegal argument for ranges.");
+				}
+				break;
+
 			// width
 			case 'w':
 				width = parse_value(optarg);
@@ -840,6 +1329,31 @@ int main(int argc, char* argv[]) {
 				hl_width = parse_value(optarg);
 				break;
 
+			// little-endian words
+			case 'e':
+				flags |= FLAG_LITTLE_ENDIAN;
+				break;
+
+			// compare mask
+			case 'a':
+				mask = parse_value(optarg);
+				flags |= FLAG_MASK;
+				break;
+
+			// tolerance
+			case 'f':
+				if (optarg[0] == '\0' || optarg[1] != ':') {
+					usage(argv[0], "Illegal argument for tolerance.");
+				}
+				tol_type = optarg[0];
+				tol_eps = strtod(optarg + 2, &end);
+				tol_rel = (*end == 'r');
+				if (end == optarg + 2 || *(end + tol_rel) != '\0') {
+					usage(argv[0], "Illegal argument for tolerance.");
+				}
+				flags |= FLAG_TOLERANCE;
+				break;
+
 			// context
 			case 'c':
 				context = parse_value(optarg);
@@ -898,6 +1412,91 @@ int main(int argc, char* argv[]) {
 				llq_num_append(ignore, tmp);
 				break;
 
+			// maximum differing lines
+			case 'm':
+				max_diff_lines = parse_value(optarg);
+				break;
+
+			// maximum differing bytes
+			case 'M':
+				max_diff_bytes = parse_value(optarg);
+				break;
+
+			// checkpoint file
+			case 'C':
+				ckpt_path = optarg;
+				break;
+
+			// resume from checkpoint
+			case 'R':
+				flags |= FLAG_RESUME;
+				break;
+
+			// threads
+			case 'T':
+				flags |= FLAG_THREADS;
+				break;
+
+			// parallel formatting
+			case 'j':
+				flags |= FLAG_PARALLEL;
+				jobs = parse_value(optarg);
+				if (jobs <= 0 || jobs > MAX_JOBS) {
+					usage(argv[0], "Illegal argument for number of threads.");
+				}
+				break;
+
+			// direct I/O
+			case 'D':
+				flags |= FLAG_DIRECT;
+				break;
+
+			// drop pages
+			case 'E':
+				flags |= FLAG_DROP;
+				break;
+
+			// heatmap
+			case 'G':
+				flags |= FLAG_HEATMAP;
+				heat_size = parse_value(optarg);
+				break;
+
+			// bit-flip analysis
+			case 'B':
+				flags |= FLAG_BITFLIP;
+				break;
+
+			// difference statistics
+			case 'k':
+				flags |= FLAG_DELTA;
+				delta_top = parse_value(optarg);
+				break;
+
+			// progress
+			case 'P':
+				flags |= FLAG_PROGRESS;
+				progress = parse_value(optarg);
+				break;
+
+			// generate signature
+			case 'g':
+				flags |= FLAG_SIGN;
+				sig_path = optarg;
+				break;
+
+			// verify against signature
+			case 'V':
+				flags |= FLAG_VERIFY;
+				sig_path = optarg;
+				break;
+
+			// block size of signatures
+			case 'W':
+				flags |= FLAG_SIG_BLOCK;
+				sig_block = parse_value(optarg);
+				break;
+
 			// buffer size
 			case 'b':
 				buf_size = parse_value(optarg);
@@ -941,32 +1540,201 @@ int main(int argc, char* argv[]) {
 	if (file_cnt <= 0) {
 		usage(argv[0], "No files specified.");
 	}
+	for (i = 0; i < file_cnt; i++) {
+		if (strncmp(filename[i], SFILE_PATTERN, strlen(SFILE_PATTERN)) != 0) {
+			break;
+		}
+	}
+	if (i == file_cnt) {
+		usage(argv[0], "At least one file must not be a pattern.");
+	}
 	if (width <= 0) {
 		usage(argv[0], "Illegal argument for width.");
 	}
 	if (hl_width <= 0 || hl_width > sizeof(size_t)) {
 		usage(argv[0], "Illegal argument for highlight width.");
 	}
+	if (sbuf_diff_word_init(&word, hl_width, (flags & FLAG_LITTLE_ENDIAN) ? 1 : 0) != 0) {
+		usage(argv[0], "Illegal argument for highlight width.");
+	}
+	if (flags & FLAG_MASK) {
+		if ((mask & ~word.mask) != 0) {
+			usage(argv[0], "Illegal argument for mask.");
+		}
+		word.mask = mask;
+	}
+	if ((flags & FLAG_TOLERANCE) && sbuf_diff_word_tolerance(&word, tol_type, tol_eps, tol_rel) != 0) {
+		usage(argv[0], "Illegal argument for tolerance.");
+	}
+	if ((flags & FLAG_SIGN) && (flags & FLAG_VERIFY)) {
+		usage(argv[0], "Cannot both generate and verify a signature.");
+	}
+	if ((flags & FLAG_SIGN) && file_cnt != 1) {
+		usage(argv[0], "A signature is generated from a single file.");
+	}
+	if ((flags & FLAG_VERIFY) && file_cnt > 2) {
+		usage(argv[0], "A signature is verified against a single file, and displayed against at most one other.");
+	}
+	if ((flags & FLAG_VERIFY) && file_cnt > 1 && strcmp(filename[file_cnt - 1], "-") == 0) {
+		usage(argv[0], "Cannot display differing blocks of STDIN verified against a signature.");
+	}
+	if (sig_path != NULL && (ranges != NULL || start_pos > 0)) {
+		usage(argv[0], "Cannot combine signatures with offset or ranges.");
+	}
+	if ((flags & FLAG_VERIFY) && len != MAX_LENGTH) {
+		usage(argv[0], "Cannot verify a signature up to a length.");
+	}
+	if ((flags & FLAG_SIG_BLOCK) && ! (flags & FLAG_SIGN)) {
+		usage(argv[0], "Block size is only set when generating a signature.");
+	}
+	if (sig_path != NULL && sig_block <= 0) {
+		usage(argv[0], "Illegal argument for block size.");
+	}
+
+	// generate or verify a signature, reading the last file once
+	if (sig_path != NULL) {
+		sg = sig_malloc(sig_path, (flags & FLAG_VERIFY) ? 1 : 0, sig_block);
+		if (sg == NULL) {
+			usage(argv[0], "Could not open signature.");
+		}
+		if ((flags & FLAG_VERIFY) && sig_read(sg) != 0) {
+			usage(argv[0], "Invalid signature.");
+		}
+		sf[0] = sfile_malloc();
+		if (sf[0] == NULL) {
+			usage(argv[0], "Could not allocate file structures.");
+		}
+		if (flags & FLAG_DIRECT) {
+			sf[0]->direct = 1;
+		}
+		if (flags & FLAG_DROP) {
+			sf[0]->drop = 1;
+		}
+		if (sfile_open(sf[0], filename[file_cnt - 1]) != 0) {
+			usage(argv[0], "Could not open files.");
+		}
+
+		// hash blocks on as many threads as formatting
+		if (jobs > 1) {
+			hashers = pool_malloc((int)jobs);
+			if (hashers == NULL) {
+				usage(argv[0], "Could not allocate threads.");
+			}
+		}
+		if (sig_file(sg, sf[0], buf_size, len, hashers) != 0) {
+			usage(argv[0], "Could not hash files.");
+		}
+		pool_free(hashers);
+		if (sfile_close(sf[0]) != 0) {
+			ret = EXIT_FAILURE;
+		}
+		sfile_free(sf[0]);
+		sf[0] = NULL;
+
+		// differing blocks, displayed as ranges against the first file
+		if ((flags & FLAG_VERIFY) && file_cnt > 1 && sg->diff->cnt > 0) {
+			ranges = sg->diff;
+			sg->diff = NULL;
+			len = MAX_LENGTH;
+		}
+		else {
+			if (flags & FLAG_VERIFY) {
+				sig_print(sg, stdout, (flags & FLAG_QUIET1) ? 1 : 0);
+			}
+			if (sig_free(sg) != 0) {
+				usage(argv[0], "Could not write signature.");
+			}
+			llq_num_free(ignore);
+			range_free(ranges);
+			if (flags & FLAG_TIME_ELAPSED) {
+				gettimeofday(&ts_end, NULL);
+				fprintf(stderr, "%f seconds\n", time_elapsed(ts_end, ts_start));
+			}
+			return ret;
+		}
+		sig_free(sg);
+	}
+
+	if (ranges != NULL && ranges->cnt == 0) {
+		usage(argv[0], "Illegal argument for ranges.");
+	}
+	if (ranges != NULL && (start_pos > 0 || len != MAX_LENGTH)) {
+		usage(argv[0], "Cannot combine ranges with offset or length.");
+	}
+	if (ranges != NULL && ckpt_path != NULL) {
+		usage(argv[0], "Cannot save a checkpoint of ranges.");
+	}
+	if (ranges != NULL && (flags & FLAG_HEATMAP)) {
+		usage(argv[0], "Cannot combine ranges and heatmap.");
+	}
+
+	// first range, sorted and coalesced with the others
+	if (ranges != NULL) {
+		range_sort(ranges);
+		start_pos = ranges->r[0].pos;
+		len = ranges->r[0].end - start_pos;
+	}
+
 	if (len <= 0) {
 		usage(argv[0], "Illegal argument for length.");
 	}
 	if (context < 0) {
 		usage(argv[0], "Illegal argument for context.");
 	}
+	if (max_diff_lines <= 0) {
+		usage(argv[0], "Illegal argument for maximum differing lines.");
+	}
+	if (max_diff_bytes <= 0) {
+		usage(argv[0], "Illegal argument for maximum differing bytes.");
+	}
 	if (buf_size <= 0) {
 		usage(argv[0], "Illegal argument for buffer size.");
 	}
 	if (buf_size < width) {
 		usage(argv[0], "Buffer size cannot be smaller than the width.");
 	}
+	tmp = (ranges != NULL ? ranges->r[ranges->cnt - 1].pos : start_pos);
 	for (i = 0; i < file_cnt; i++) {
-		if ((start_pos + seek[i]) < start_pos) {
+		if ((tmp + seek[i]) < tmp) {
 			usage(argv[0], "Illegal argument for seek.");
 		}
 	}
 	if (! (flags & (FLAG_HEX | FLAG_ASCII))) {
 		usage(argv[0], "Cannot exclude both hexadecimal and ASCII.");
 	}
+	if ((flags & FLAG_RESUME) && ckpt_path == NULL) {
+		usage(argv[0], "Cannot resume without a checkpoint file.");
+	}
+	if ((flags & FLAG_HEATMAP) && heat_size <= 0) {
+		usage(argv[0], "Illegal argument for heatmap bucket size.");
+	}
+	if ((flags & FLAG_HEATMAP) && ckpt_path != NULL) {
+		usage(argv[0], "Cannot save a checkpoint of a heatmap.");
+	}
+	if ((flags & FLAG_BITFLIP) && hl_width > 8) {
+		usage(argv[0], "Bit-flip analysis requires a highlight width of at most 8.");
+	}
+	if ((flags & FLAG_BITFLIP) && ckpt_path != NULL) {
+		usage(argv[0], "Cannot save a checkpoint of bit-flip analysis.");
+	}
+	if ((flags & FLAG_BITFLIP) && (flags & FLAG_HEATMAP)) {
+		usage(argv[0], "Cannot combine heatmap and bit-flip analysis.");
+	}
+	if ((flags & FLAG_DELTA) && delta_top <= 0) {
+		usage(argv[0], "Illegal argument for number of differences.");
+	}
+	if ((flags & FLAG_DELTA) && hl_width > 8) {
+		usage(argv[0], "Difference statistics require a highlight width of at most 8.");
+	}
+	if ((flags & FLAG_REPEAT) && ckpt_path != NULL) {
+		usage(argv[0], "Cannot save a checkpoint of collapsed lines.");
+	}
+	if ((flags & FLAG_DELTA) && ckpt_path != NULL) {
+		usage(argv[0], "Cannot save a checkpoint of difference statistics.");
+	}
+	if ((flags & FLAG_DELTA) && (flags & (FLAG_HEATMAP | FLAG_BITFLIP))) {
+		usage(argv[0], "Cannot combine difference statistics with heatmap or bit-flip analysis.");
+	}
 
 	// initiailize position
 	pos = start_pos;
@@ -992,17 +1760,38 @@ int main(int argc, char* argv[]) {
 		usage(argv[0], "Could not allocate difference buffer.");
 	}
 
+	// one arena for the structures and buffers of all files
+	arena = mem_arena_malloc(file_cnt * (sizeof(sfile) + sizeof(sbuf) + buf_size + (3 * SFILE_DIRECT_ALIGN)));
+	if (arena == NULL) {
+		usage(argv[0], "Could not allocate file buffers.");
+	}
+
 	// allocate file buffers
 	for (i = 0; i < file_cnt; i++) {
 
 		// allocate file structures
-		sf[i] = sfile_malloc();
+		sf[i] = sfile_malloc_arena(arena);
 		if (sf[i] == NULL) {
 			usage(argv[0], "Could not allocate file structures.");
 		}
 
-		// allocate file buffers
-		sb[i] = sbuf_malloc(buf_size);
+		// direct I/O, if supported by the file
+		if (flags & FLAG_DIRECT) {
+			sf[i]->direct = 1;
+		}
+
+		// drop pages once read
+		if (flags & FLAG_DROP) {
+			sf[i]->drop = 1;
+		}
+
+		// allocate file buffers, aligned for direct I/O
+		if (flags & FLAG_DIRECT) {
+			sb[i] = sbuf_malloc_arena(arena, buf_size, SFILE_DIRECT_ALIGN);
+		}
+		else {
+			sb[i] = sbuf_malloc_arena(arena, buf_size, 1);
+		}
 		if (sb[i] == NULL) {
 			usage(argv[0], "Could not allocate file buffers.");
 		}
@@ -1016,6 +1805,91 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
+	// allocate previous line of each file
+	if (flags & FLAG_REPEAT) {
+		prev_line = (unsigned char*)malloc(width * file_cnt);
+		if (prev_line == NULL) {
+			usage(argv[0], "Could not allocate previous line.");
+		}
+		for (i = 0; i < file_cnt; i++) {
+			prev_len[i] = (size_t)-1;
+		}
+	}
+
+	// allocate heatmap, with buckets of whole lines
+	if (flags & FLAG_HEATMAP) {
+		heat_size += (width - (heat_size % width)) % width;
+		heat = heatmap_malloc(heat_size, start_pos, (flags & FLAG_QUIET1) ? 1 : 0, stdout);
+		if (heat == NULL) {
+			usage(argv[0], "Could not allocate heatmap.");
+		}
+	}
+
+	// allocate bit-flip statistics
+	if (flags & FLAG_BITFLIP) {
+		flip = bitflip_malloc(&word, stdout);
+		if (flip == NULL) {
+			usage(argv[0], "Could not allocate bit-flip statistics.");
+		}
+	}
+
+	// allocate difference statistics
+	if (flags & FLAG_DELTA) {
+		dt = delta_malloc(&word, delta_top, stdout);
+		if (dt == NULL) {
+			usage(argv[0], "Could not allocate difference statistics.");
+		}
+	}
+
+	// allocate pipeline, comparing in batches of differing lines
+	tmp = buf_size / width;
+	if (tmp > BATCH_LINES) {
+		tmp = BATCH_LINES;
+	}
+	pipeline = sbuf_pipe_malloc(sf, sb, file_cnt, width, tmp, (flags & FLAG_THREADS) ? 1 : 0);
+	if (pipeline == NULL) {
+		usage(argv[0], "Could not allocate pipeline.");
+	}
+	pipeline->word = word;
+	pipeline->ignore = ignore;
+
+	// allocate threads and output of each part for parallel formatting
+	if (jobs > 1) {
+		workers = pool_malloc((int)jobs);
+		if (workers == NULL) {
+			usage(argv[0], "Could not allocate threads.");
+		}
+		rd.out = (FILE**)malloc(sizeof(FILE*) * workers->cnt);
+		rd.buf = (char**)malloc(sizeof(char*) * workers->cnt);
+		rd.len = (size_t*)malloc(sizeof(size_t) * workers->cnt);
+		if (rd.out == NULL || rd.buf == NULL || rd.len == NULL) {
+			usage(argv[0], "Could not allocate threads.");
+		}
+		for (i = 0; i < workers->cnt; i++) {
+			rd.out[i] = open_memstream(&rd.buf[i], &rd.len[i]);
+			if (rd.out[i] == NULL) {
+				usage(argv[0], "Could not allocate threads.");
+			}
+		}
+		rd.sb_cnt = file_cnt;
+		rd.f_excl = f_excl;
+		rd.empty = diff;
+		rd.width = width;
+		rd.flags = flags;
+	}
+
+	// NULL bytes are compared as different
+	if (flags & FLAG_NULL_BYTES_DIFF) {
+		pipeline->nbd = 1;
+	}
+
+	// lines are only printed for differences, so the data of the last file
+	// left can be skipped once NULL bytes cannot differ
+	else if (! (flags & FLAG_VERBOSE) && file_cnt > 1) {
+		pipeline->skip = 1;
+		pipeline->context = context;
+	}
+
 	// open files
 	for (i = 0; i < file_cnt; i++) {
 		if (sfile_open(sf[i], filename[i]) != 0) {
@@ -1023,351 +1897,700 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
-	// seek and shift
-	for (i = 0; i < file_cnt; i++) {
+	// allocate checkpoint
+	if (ckpt_path != NULL) {
+		ck = ckpt_malloc(file_cnt);
+		if (ck == NULL) {
+			usage(argv[0], "Could not allocate checkpoint.");
+		}
+		ck->width = width;
+		ck->start_pos = start_pos;
+		ck->end_pos = end_pos;
+		ck->flags = flags & FLAG_OUTPUT;
+		ck->context = context;
+		ck->hl_width = hl_width;
+		ck->mask = mask;
+		ck->tol_type = tol_type;
+		ck->tol_eps = tol_eps;
+		ck->tol_rel = tol_rel;
+		ck->max_diff_lines = max_diff_lines;
+		ck->max_diff_bytes = max_diff_bytes;
+		if (ckpt_set_ignore(ck, ignore) != 0) {
+			usage(argv[0], "Could not allocate checkpoint.");
+		}
 
-		// temporary seek position
-		tmp = start_pos + seek[i];
+		// files must be seekable to resume, and are identified so that
+		// only the same files are resumed
+		for (i = 0; i < file_cnt; i++) {
+			if (strcmp(filename[i], "-") == 0 || (sf[i]->size < 0 && sf[i]->pat_len == 0)) {
+				usage(argv[0], "Cannot save a checkpoint of unseekable files.");
+			}
+			if (ckpt_id_file(ck, i, filename[i], sf[i]) != 0) {
+				usage(argv[0], "Could not allocate checkpoint.");
+			}
+			ck->file[i].seek = seek[i];
+			ck->file[i].shift = shift[i];
+			ck->file[i].excl = f_excl[i];
+		}
+	}
 
-		// position is not negated by shift
-		if (tmp > shift[i]) {
+	// resume from checkpoint
+	if (flags & FLAG_RESUME) {
 
-			// seek
-			sfile_seek(sf[i], sb[i], tmp - shift[i]);
+		// read checkpoint, restoring cache
+		if (ckpt_read(ck, cache, ckpt_path) != 0) {
+			usage(argv[0], "Could not read checkpoint.");
+		}
+		if (ck->width != width || ck->start_pos != start_pos || ck->end_pos != end_pos
+			|| ck->flags != (flags & FLAG_OUTPUT)
+			|| ck->context != context
+			|| ck->hl_width != hl_width
+			|| ck->mask != mask
+			|| ck->tol_type != tol_type || ck->tol_eps != tol_eps || ck->tol_rel != tol_rel
+			|| ck->max_diff_lines != max_diff_lines || ck->max_diff_bytes != max_diff_bytes
+			|| ckpt_match_ignore(ck, ignore) != 0) {
+			usage(argv[0], "Checkpoint does not match options.");
+		}
+		for (i = 0; i < file_cnt; i++) {
+			if (ck->file[i].seek != seek[i] || ck->file[i].shift != shift[i] || ck->file[i].excl != f_excl[i]) {
+				usage(argv[0], "Checkpoint does not match options.");
+			}
+		}
+		for (i = 0; i < file_cnt; i++) {
+			if (ckpt_match_file(ck, i, filename[i], sf[i]) != 0) {
+				usage(argv[0], "Checkpoint does not match files.");
+			}
+		}
 
-			// set new position
-			sb[i]->pos = start_pos;
-			sf[i]->start_pos = start_pos;
+		// restore files
+		for (i = 0; i < file_cnt; i++) {
+			if (ckpt_restore_file(ck, i, sf[i], sb[i]) != 0) {
+				usage(argv[0], "Could not restore checkpoint.");
+			}
 		}
-		else {
 
-			// shift
-			sfile_shift(sf[i], sb[i], shift[i]);
+		// restore tracking variables
+		pos = ck->pos;
+		context_after = ck->context_after;
+		spacer_printed = ck->spacer_printed;
+		diff_lines = ck->diff_lines;
+		diff_bytes = ck->diff_bytes;
+
+		// discard any output after the checkpoint
+		if (ck->out >= 0 && fstat(fileno(stdout), &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= ck->out) {
+			if (ftruncate(fileno(stdout), ck->out) == 0) {
+				lseek(fileno(stdout), ck->out, SEEK_SET);
+			}
+		}
+	}
+
+	// seek and shift
+	if (! (flags & FLAG_RESUME)) {
+		seek_files(sf, sb, file_cnt, start_pos, end_pos, seek, shift);
+	}
+
+	// end position for progress, limited by size of files
+	prog_end = (ranges != NULL ? ranges->r[ranges->cnt - 1].end : end_pos);
+	if (prog_end == MAX_LENGTH) {
+		prog_end = 0;
+		for (i = 0; i < file_cnt; i++) {
+
+			// size of file is unknown
+			size = sf[i]->size;
+			if (size < 0) {
+				prog_end = MAX_LENGTH;
+				break;
+			}
+
+			// end of data in file, after any data already read
+			tmp = sb[i]->pos + sb[i]->len;
+			if ((size_t)size > sf[i]->offset) {
+				tmp += (size_t)size - sf[i]->offset;
+			}
+			if (tmp > prog_end) {
+				prog_end = tmp;
+			}
 		}
+	}
 
-		// initial file read
+	// initial file read
+	for (i = 0; i < file_cnt; i++) {
 		sfile_read(sf[i], sb[i]);
 	}
 
-	/******************************/
+	// request progress reports with a timer and SIGUSR1
+	prog_pos = pos;
+	for (i = 0; i < file_cnt; i++) {
+		prog_bytes[i] = sf[i]->bytes_read;
+	}
+	if (flags & FLAG_PROGRESS) {
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = progress_signal;
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &sa, NULL);
+		if (progress > 0) {
+			sigaction(SIGALRM, &sa, NULL);
+			it.it_interval.tv_sec = progress;
+			it.it_interval.tv_usec = 0;
+			it.it_value = it.it_interval;
+			setitimer(ITIMER_REAL, &it, NULL);
+		}
+	}
 
-	if (! (flags & FLAG_QUIET1)) {
+	// start reading and comparing
+	if (sbuf_pipe_start(pipeline, pos, end_pos) != 0) {
+		usage(argv[0], "Could not start pipeline.");
+	}
 
-		// print spaces in place of position
-		print_empty_pos(pos, flags);
+	/******************************/
 
-		// loop through files
-		for (i = 0; i < file_cnt; i++) {
+	// heatmap header
+	if (heat != NULL) {
+		if (! (flags & FLAG_QUIET1)) {
+			heatmap_print_header(heat);
+		}
+	}
 
-			if (! f_excl[i]) {
-				// print file name
-				print_string(
-					filename[i],
-					wspaces(width, flags),
-					flags
-				);
-			}
+	// bit-flip header
+	else if (flip != NULL) {
+		if (! (flags & FLAG_QUIET1)) {
+			bitflip_print_header(flip);
+		}
+	}
+
+	// difference statistics header
+	else if (dt != NULL) {
+		if (! (flags & FLAG_QUIET1)) {
+			delta_print_header(dt);
 		}
+	}
 
-		printf("\n");
+	// header was already printed before resuming
+	else if (! (flags & FLAG_QUIET1) && ! (flags & FLAG_RESUME)) {
+		print_header(stdout, filename, file_cnt, f_excl, pos, width, flags);
 	}
 
 	/******************************/
 
 	// main loop
 	loop = 1;
-	while (loop) {
+	while (1) {
 
-		// assume files are not end-of-output
-		eoo_cnt = 0;
+		// next batch of compared lines
+		pb = sbuf_pipe_next(pipeline);
+		batch = pb->batch;
+		wsb = pb->w->sb;
+		wsf = pb->w->sf;
 
-		// calculate maximum width of this line according to length
-		mlw = width;
-		if (pos < end_pos && end_pos < (pos + width)) {
-			mlw = end_pos - pos;
-		}
+		// all files are end-of-output
+		if (pb->w->end) {
+			sbuf_pipe_release(pipeline, pb);
 
-		// loop through files
-		for (i = 0; i < file_cnt; i++) {
+			// last range, or a limit was reached
+			if (ranges == NULL || range_idx + 1 >= ranges->cnt || diff_lines >= max_diff_lines || diff_bytes >= max_diff_bytes) {
+				break;
+			}
 
-			// ensure there is enough data in the buffer
-			while (! sf[i]->eof && sbuf_avail(sb[i], pos) < width) {
+			// end of this range, the same as the end of output
+			if (context > 0 && cache[0]->active.size > 0 && ! spacer_printed) {
+				print_spacer(stdout, flags);
+			}
+			if (flip == NULL && dt == NULL && ! (flags & FLAG_QUIET1)) {
+				print_footer(stdout, sf, file_cnt, f_excl, pos, end_pos, width, flags);
+			}
 
-				// shift/reduce buffer
-				sbuf_reduce(sb[i], pos);
+			// seek directly to the next range
+			range_idx++;
+			pos = ranges->r[range_idx].pos;
+			end_pos = ranges->r[range_idx].end;
+			seek_files(sf, sb, file_cnt, pos, end_pos, seek, shift);
+			for (i = 0; i < file_cnt; i++) {
+				sfile_read(sf[i], sb[i]);
+			}
+			if (sbuf_pipe_start(pipeline, pos, end_pos) != 0) {
+				usage(argv[0], "Could not start pipeline.");
+			}
 
-				// read more data from file
-				br = sfile_read(sf[i], sb[i]);
-				if (br < 0) {
-					break;
+			// nothing is carried over from the previous range
+			loop = 1;
+			context_after = MAX_LENGTH;
+			spacer_printed = 0;
+			for (i = 0; i < file_cnt; i++) {
+				if (cache[i] != NULL) {
+					sbuf_cache_purge(cache[i]);
 				}
+				prev_len[i] = (size_t)-1;
 			}
-
-			// end of output
-			if (sfile_eoo(sf[i], sb[i], pos) != 0) {
-				eoo_cnt++;
+			if (flip == NULL && dt == NULL && ! (flags & FLAG_QUIET1)) {
+				print_header(stdout, filename, file_cnt, f_excl, pos, width, flags);
 			}
+			continue;
 		}
 
-		/*****/
-
-		// all files are end-of-output
-		if (eoo_cnt == file_cnt) {
-			loop = 0;
-			break;
+		// output has ended, discard lines still in flight
+		if (! loop) {
+			sbuf_pipe_release(pipeline, pb);
+			continue;
 		}
 
-		// reset difference structure
-		sbuf_diff_init(diff);
+		// position and number of compared lines
+		pos = batch->pos;
+		lines = batch->lines;
+
+		// heatmap, bit-flip analysis or difference statistics, only visit
+		// the differing lines instead of printing lines
+		if (heat != NULL || flip != NULL || dt != NULL) {
+			for (k = 0; k < batch->cnt && loop; k++) {
+				d = batch->diff[k];
+				tmp = pos + (batch->idx[k] * width);
+				if (d->cnt > 0) {
+					if (heat != NULL) {
+						heatmap_add(heat, tmp, d->cnt);
+					}
+					if (flip != NULL) {
+						bitflip_add(flip, wsb, file_cnt, tmp, d);
+					}
+					if (dt != NULL) {
+						delta_add(dt, tmp, d);
+					}
+					diff_lines++;
+					diff_bytes += d->cnt;
+				}
+
+				// difference limit reached, output ends with this line
+				if (diff_lines >= max_diff_lines || diff_bytes >= max_diff_bytes) {
+					if (tmp + width < end_pos) {
+						end_pos = tmp + width;
+					}
+					sbuf_pipe_stop(pipeline);
+					loop = 0;
+				}
+			}
 
-		// NULL bytes are compared as different
-		if (flags & FLAG_NULL_BYTES_DIFF) {
-			diff->nbd = 1;
+			// no lines are printed
+			pos += lines * width;
+			lines = 0;
 		}
 
-		// loop doubly through files for comparison
-		for (i = 1; i < file_cnt; i++) {
-		for (j = 0; j < i; j++) {
+		// every line is printed, format the lines in parallel
+		// unless repeated lines are collapsed or context is pending
+		if (workers != NULL && (flags & FLAG_VERBOSE || file_cnt == 1) && ! (flags & FLAG_REPEAT) && (context == 0 || cache[0]->active.size == 0)) {
+
+			// count differences and find the last line, as the loop
+			// through lines below would
+			rd.pos = pos;
+			rd.end_pos = end_pos;
+			k = 0;
+			for (line = 0; line < lines && loop; line++) {
+
+				// calculate maximum width of this line according to length
+				mlw = width;
+				if (pos < end_pos && end_pos < (pos + width)) {
+					mlw = end_pos - pos;
+				}
+
+				// count differences toward the limits
+				if (k < batch->cnt && batch->idx[k] == line) {
+					if (batch->diff[k]->cnt > 0) {
+						diff_lines++;
+						diff_bytes += batch->diff[k]->cnt;
+					}
+					k++;
+				}
+
+				// difference limit reached, output ends with this line
+				if (diff_lines >= max_diff_lines || diff_bytes >= max_diff_bytes) {
+					end_pos = pos + mlw;
+					sbuf_pipe_stop(pipeline);
+					loop = 0;
+				}
+
+				// position overflow or past specified length
+				else if ((pos + width) < pos || (pos + width) >= end_pos) {
+					loop = 0;
+				}
 
-			// compare lines
-			if (sbuf_diff_cmp(sb[j], sb[i], pos, mlw, diff, hl_width) > 0) {
+				// increment position for loop
+				else {
+					pos += width;
+				}
+			}
+			rd.lines = line;
+			if (line > 0) {
+				spacer_printed = 0;
+			}
 
-				// unmark ignore values
-				sbuf_diff_unmark_ignore(diff, hl_width, ignore);
+			// format parts, then write them in order
+			rd.sb = wsb;
+			rd.batch = batch;
+			pool_run(workers, render_part, &rd);
+			for (i = 0; i < workers->cnt; i++) {
+				fflush(rd.out[i]);
+				fwrite(rd.buf[i], 1, rd.len[i], stdout);
+				fseeko(rd.out[i], 0, SEEK_SET);
 			}
-		}
+
+			// no lines are left to print
+			lines = 0;
 		}
 
 		/*****/
 
-		// determine if the current line should be printed or not
-		print_line = 0;
+		// loop through lines
+		k = 0;
+		for (line = 0; line < lines; line++) {
 
-		// always print
-		if (flags & FLAG_VERBOSE || file_cnt == 1) {
-			print_line = 1;
-		}
+			// calculate maximum width of this line according to length
+			mlw = width;
+			if (pos < end_pos && end_pos < (pos + width)) {
+				mlw = end_pos - pos;
+			}
 
-		// at least one difference
-		else if (diff->cnt > 0) {
-			print_line = 1;
+			// use empty difference structure unless line differs
+			d = diff;
+			if (k < batch->cnt && batch->idx[k] == line) {
+				d = batch->diff[k];
+				k++;
+			}
 
-			// reset context
-			context_after = 0;
-		}
+			// determine if the current line should be printed or not
+			print_line = 0;
+			repeat = 0;
 
-		// context after a matching line
-		else if (context_after < context) {
-			print_line = 1;
+			// always print, unless collapsed
+			if (flags & FLAG_VERBOSE || file_cnt == 1) {
+				print_line = 1;
 
-			// increment context
-			context_after++;
-		}
+				// same as the previous line
+				if ((flags & FLAG_REPEAT) && line_repeat(wsb, file_cnt, pos, width, mlw, prev_line, prev_len)) {
+					print_line = 0;
+					repeat = 1;
+				}
 
-		/*****/
+				// count differences toward the limits
+				if (d->cnt > 0) {
+					diff_lines++;
+					diff_bytes += d->cnt;
+				}
+			}
 
-		// print current line
-		if (print_line) {
+			// at least one difference
+			else if (d->cnt > 0) {
+				print_line = 1;
 
-			// reset spacer
-			spacer_printed = 0;
+				// reset context
+				context_after = 0;
 
-			// print cache lines first
-			// assumes each file has same number of cache entries
-			while (context > 0 && cache[0]->active.size > 0) {
+				// count differences toward the limits
+				diff_lines++;
+				diff_bytes += d->cnt;
+			}
 
-				// determine position by counting backwards
-				// NOTE: do not use position stored in cache
-				tmp_pos = pos - (cache[0]->active.size * width);
-				if (tmp_pos > pos) {
-					tmp_pos = 0;
-				}
+			// context after a matching line
+			else if (context_after < context) {
+				print_line = 1;
 
-				// loop through cache for each file
-				for (i = 0; i < file_cnt; i++) {
+				// increment context
+				context_after++;
+			}
+
+			/*****/
+
+			// print current line
+			if (print_line) {
 
-					// get next entry from cache
-					tmp_sb = sbuf_cache_remove(cache[i]);
+				// reset spacer
+				spacer_printed = 0;
 
-					// print cache
-					if (tmp_sb != NULL && ! f_excl[i]) {
+				// print cache lines first
+				// assumes each file has same number of cache entries
+				while (context > 0 && cache[0]->active.size > 0) {
 
-						// print position
-						if (i == 0) {
-							print_pos(
+					// determine position by counting backwards
+					// NOTE: do not use position stored in cache
+					tmp_pos = pos - (cache[0]->active.size * width);
+					if (tmp_pos > pos) {
+						tmp_pos = 0;
+					}
+
+					// loop through cache for each file
+					for (i = 0; i < file_cnt; i++) {
+
+						// get next entry from cache
+						tmp_sb = sbuf_cache_remove(cache[i]);
+
+						// print cache
+						if (tmp_sb != NULL && ! f_excl[i]) {
+
+							// print position
+							if (i == 0) {
+								print_pos(
+									stdout,
+									tmp_pos,
+									flags
+								);
+							}
+
+							// print cache buffer
+							print_sbuf(
+								stdout,
+								tmp_sb,
 								tmp_pos,
+								width,
+								mlw,
+								NULL,
 								flags
 							);
 						}
-
-						// print cache buffer
-						print_sbuf(
-							tmp_sb,
-							tmp_pos,
-							width,
-							mlw,
-							NULL,
-							flags
-						);
 					}
+					printf("\n");
 				}
-				printf("\n");
-			}
 
-			// print position
-			print_pos(pos, flags);
+				// print current line of files
+				print_files(stdout, wsb, file_cnt, f_excl, pos, width, mlw, d, flags);
+			}
 
-			// loop through files
-			for (i = 0; i < file_cnt; i++) {
+			/*****/
 
-				if (! f_excl[i]) {
-					// print current line of file
-					print_sbuf(sb[i],
-						pos,
-						width,
-						mlw,
-						diff,
-						flags
-					);
+			// do not print repeated line, print spacer instead
+			else if (repeat) {
+				if (! spacer_printed) {
+					print_spacer(stdout, flags);
+					spacer_printed = 1;
 				}
 			}
 
-			// print subtraction differences last
-			// only print if there is at least one difference
-			// or if the verbose flag is set
-			tmp = 0;
-			if ((diff->cnt > 0) || (flags & FLAG_VERBOSE)) {
-				tmp = 1;
-			}
-			if (flags & FLAG_DISP_DIFF && tmp) {
-
-				if (! f_excl[i]) {
-					// print differences
-					print_diff(
-						diff,
-						pos,
-						width,
-						mlw,
-						flags
-					);
+			/*****/
+
+			// do not print line, add to cache
+			else if (context > 0) {
+
+				// number of lines until the next difference
+				run = (k < batch->cnt ? batch->idx[k] : lines) - line;
+
+				// lines will be removed from the cache
+				if (cache[0]->active.size + run > context) {
+
+					// print spacer
+					if (! spacer_printed) {
+						print_spacer(stdout, flags);
+						spacer_printed = 1;
+					}
+
+					// skip lines that would be removed anyway
+					if (run > context) {
+						for (i = 0; i < file_cnt; i++) {
+							sbuf_cache_purge(cache[i]);
+						}
+						line += run - context;
+						pos += (run - context) * width;
+						run = context;
+					}
 				}
-			}
 
-			// print newline
-			print_nl(flags);
-		}
+				// add remaining lines to cache
+				while (run > 0) {
 
-		/*****/
+					// loop through files
+					for (i = 0; i < file_cnt; i++) {
 
-		// do not print line, add to cache
-		else if (context > 0) {
+						// update cache
+						cache_add(wsb[i], cache[i], pos, context);
+					}
 
-			// loop through files
-			for (i = 0; i < file_cnt; i++) {
+					// next line, except for the last
+					run--;
+					if (run > 0) {
+						line++;
+						pos += width;
+					}
+				}
+			}
 
-				// update cache
-				tmp = cache_add(sb[i], cache[i], pos, context);
+			/*****/
 
-				// print spacer
-				if (! spacer_printed && i == 0 && tmp > 0) {
-					print_spacer(flags);
+			// do not print line, print spacer instead
+			else {
+				if (! spacer_printed) {
+					print_spacer(stdout, flags);
 					spacer_printed = 1;
 				}
+
+				// skip to the last line before the next difference
+				run = (k < batch->cnt ? batch->idx[k] : lines) - line;
+				line += run - 1;
+				pos += (run - 1) * width;
 			}
-		}
 
-		/*****/
+			/*****/
 
-		// do not print line, print spacer instead
-		else if (! spacer_printed) {
-			print_spacer(flags);
-			spacer_printed = 1;
-		}
+			// difference limit reached
+			if (diff_lines >= max_diff_lines || diff_bytes >= max_diff_bytes) {
 
-		/*****/
+				// output ends with the current line
+				end_pos = pos + mlw;
+
+				// stop reading immediately
+				sbuf_pipe_stop(pipeline);
+
+				loop = 0;
+			}
+
+			// position overflow
+			else if ((pos + width) < pos) {
+				loop = 0;
+			}
+
+			// new position is past specified length
+			else if ((pos + width) >= end_pos) {
+				loop = 0;
+			}
+
+			// increment position for loop
+			else {
+				pos += width;
+			}
 
-		// position overflow
-		if ((pos + width) < pos) {
-			loop = 0;
+			// stop processing lines
+			if (! loop) {
+				break;
+			}
 		}
 
-		// new position is past specified length
-		else if ((pos + width) >= end_pos) {
-			loop = 0;
+		// save checkpoint periodically
+		if (loop && ck != NULL) {
+			gettimeofday(&ts_now, NULL);
+			if (time_elapsed(ts_now, ts_ckpt) >= CKPT_INTERVAL) {
+
+				// position of output
+				fflush(stdout);
+				ck->out = lseek(fileno(stdout), 0, SEEK_CUR);
+
+				// save tracking variables
+				ck->pos = pos;
+				ck->context_after = context_after;
+				ck->spacer_printed = spacer_printed;
+				ck->diff_lines = diff_lines;
+				ck->diff_bytes = diff_bytes;
+
+				// save files
+				for (i = 0; i < file_cnt; i++) {
+					ckpt_save_file(ck, i, &wsf[i], wsb[i], pos);
+				}
+
+				if (ckpt_write(ck, cache, ckpt_path) != 0) {
+					fprintf(stderr, "Could not write checkpoint.\n");
+				}
+				ts_ckpt = ts_now;
+			}
 		}
 
-		// increment position for loop
-		else {
-			pos += width;
+		// report progress when requested
+		if (progress_requested) {
+			progress_requested = 0;
 
-			// attempt to re-read from files solely to determine
-			// if EOF has been reached, otherwise if last read was
-			// the exact size of the buffer there is no way to
-			// know if EOF was reached
+			// calculate deltas since last report
+			gettimeofday(&ts_now, NULL);
 			for (i = 0; i < file_cnt; i++) {
-				sfile_read(sf[i], sb[i]);
+				tmp = wsf[i].bytes_read;
+				prog_bytes[i] = tmp - prog_bytes[i];
+			}
+
+			print_progress(
+				pos,
+				prog_end,
+				diff_lines,
+				time_elapsed(ts_now, ts_prog),
+				pos - prog_pos,
+				filename,
+				prog_bytes,
+				file_cnt
+			);
+
+			// save values for next report
+			ts_prog = ts_now;
+			prog_pos = pos;
+			for (i = 0; i < file_cnt; i++) {
+				prog_bytes[i] = wsf[i].bytes_read;
 			}
 		}
+
+		// lines are printed, buffers can be reused
+		sbuf_pipe_release(pipeline, pb);
 	} // main loop
 
+	// wait for the pipeline, files are no longer in use
+	if (sbuf_pipe_free(pipeline) != 0) {
+		ret = EXIT_FAILURE;
+	}
+
 	/******************************/
 
 	// data in cache, print final spacer
 	// NOTE: occurs if context is larger than files to compare
 	if (context > 0 && cache[0]->active.size > 0) {
 		if (! spacer_printed) {
-			print_spacer(flags);
+			print_spacer(stdout, flags);
 			spacer_printed = 1;
 		}
 	}
 
-	if (! (flags & FLAG_QUIET1)) {
-
-		// print spaces in place of last position
-		if (pos >= width) {
-			print_empty_pos(pos - width, flags);
-		}
-		else {
-			print_empty_pos(0, flags);
+	// complete heatmap
+	if (heat != NULL) {
+		heatmap_end(heat, (pos < end_pos ? pos : end_pos));
+		if (! (flags & FLAG_QUIET1)) {
+			heatmap_print_footer(heat);
 		}
+	}
 
-		// loop through files
-		for (i = 0; i < file_cnt; i++) {
-
-			if (! f_excl[i]) {
-
-				// output was truncated
-				if (end_pos > sf[i]->start_pos) {
-					tmp = end_pos - sf[i]->start_pos;
-				}
-				// entire buffer was NULL bytes at beginning
-				else {
-					tmp = 0;
-				}
-				// use all bytes read if before end_pos
-				if (sf[i]->bytes_read < tmp) {
-					tmp = sf[i]->bytes_read;
-				}
+	// bit-flip totals and histogram
+	else if (flip != NULL) {
+		bitflip_print_footer(flip);
+	}
 
-				// print number of bytes per file
-				print_bytes(tmp, wspaces(width, flags), flags);
-			}
-		}
+	// difference totals, most frequent and largest
+	else if (dt != NULL) {
+		delta_print_footer(dt);
+	}
 
-		printf("\n");
+	else if (! (flags & FLAG_QUIET1)) {
+		print_footer(stdout, sf, file_cnt, f_excl, pos, end_pos, width, flags);
 	}
 
 	/*****/
 
+	// comparison is complete, checkpoint is no longer needed
+	if (ck != NULL) {
+		remove(ckpt_path);
+		ckpt_free(ck);
+	}
+
 	// close files and free buffers
+	heatmap_free(heat);
+	bitflip_free(flip);
+	delta_free(dt);
+	free(prev_line);
+	if (workers != NULL) {
+		for (i = 0; i < workers->cnt; i++) {
+			fclose(rd.out[i]);
+			free(rd.buf[i]);
+		}
+		pool_free(workers);
+		free(rd.out);
+		free(rd.buf);
+		free(rd.len);
+	}
 	llq_num_free(ignore);
+	range_free(ranges);
 	sbuf_diff_free(diff);
 	for (i = 0; i < file_cnt; i++) {
-		sfile_close(sf[i]);
-		sfile_free(sf[i]);
-		sbuf_free(sb[i]);
+		if (sfile_close(sf[i]) != 0) {
+			ret = EXIT_FAILURE;
+		}
 		sbuf_cache_free(cache[i]);
 	}
+	mem_arena_free(arena);
 
 	// print elapsed time
 	if (flags & FLAG_TIME_ELAPSED) {
@@ -1375,7 +2598,7 @@ int main(int argc, char* argv[]) {
 		fprintf(stderr, "%f seconds\n", time_elapsed(ts_end, ts_start));
 	}
 
-	return 0;
+	return ret;
 }
 
 /**********************************************************/
@@ -0,0 +1,242 @@
+/*
+ * mem - aligned memory and arenas
+ *
+ * Provides memory aligned to at least a cache line, so that buffers can be
+ * compared with the widest vector loads and never share a cache line with
+ * other data. Large allocations, such as file buffers raised with -b, are
+ * mapped on huge pages when the system has them reserved, or otherwise marked
+ * for transparent huge pages, so that they take few TLB entries. Each block
+ * records how it was allocated just before the returned memory, so that it is
+ * freed the same way.
+ *
+ * Also provides arenas, from which structures that live as long as each other
+ * are allocated next to each other in a single block, and freed all at once.
+ */
+
+#include <stdio.h>		// NULL
+#include <stdlib.h>		// malloc(), free(), posix_memalign()
+#include <stdint.h>		// uintptr_t
+#include <sys/mman.h>		// mmap(), munmap(), madvise()
+#include "mem.h"
+
+// allocated memory, stored just before the aligned memory returned
+struct mem_header {
+	void* base;		// allocated memory
+	size_t len;		// length of mapped memory
+	int mapped;		// flag for mapped memory instead of heap memory
+};
+typedef struct mem_header mem_header;
+
+// block of an arena, stored at the start of the block
+struct mem_block {
+	struct mem_block* next;	// earlier block
+	size_t size;		// number of bytes after the block structure
+	size_t used;		// number of bytes allocated so far
+};
+typedef struct mem_block mem_block;
+
+/**********************************************************/
+/*
+ * Maps the given length of memory, on huge pages if possible. Returns the
+ * mapped memory, or NULL if error.
+ */
+static void* mem_map(size_t len) {
+	void* base;
+
+	base = MAP_FAILED;
+
+	// huge pages reserved by the system
+#ifdef MAP_HUGETLB
+	base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+
+	// transparent huge pages
+	if (base == MAP_FAILED) {
+		base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED) {
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		madvise(base, len, MADV_HUGEPAGE);
+#endif
+	}
+
+	return base;
+}
+
+/**********************************************************/
+/*
+ * Allocates the given number of bytes aligned to the given alignment, which
+ * is raised to MEM_ALIGN and must be a power of two. Allocations of at least
+ * MEM_HUGE bytes are mapped in multiples of huge pages. Returns the allocated
+ * memory, which must be freed with mem_free(), or NULL if error.
+ */
+void* mem_alloc(size_t size, size_t align) {
+	mem_header* h;
+	void* base;
+	size_t len;
+	int mapped;
+
+	// check parameters
+	if (align < MEM_ALIGN) {
+		align = MEM_ALIGN;
+	}
+	if (size == 0 || (align & (align - 1)) != 0) {
+		return NULL;
+	}
+
+	// room for the header before the aligned memory
+	len = size + align;
+	if (len < size) {
+		return NULL;
+	}
+
+	// large allocation, mapped on huge pages
+	base = NULL;
+	mapped = 0;
+	if (len >= MEM_HUGE && align <= MEM_PAGE) {
+		len += (MEM_HUGE - (len % MEM_HUGE)) % MEM_HUGE;
+		base = mem_map(len);
+		mapped = (base != NULL);
+	}
+
+	// heap memory
+	if (base == NULL && posix_memalign(&base, align, size + align) != 0) {
+		return NULL;
+	}
+
+	// header just before the aligned memory
+	h = (mem_header*)((unsigned char*)base + align) - 1;
+	h->base = base;
+	h->len = len;
+	h->mapped = mapped;
+
+	return (unsigned char*)base + align;
+}
+
+/**********************************************************/
+/*
+ * Frees the given memory allocated with mem_alloc().
+ */
+void mem_free(void* ptr) {
+	mem_header* h;
+
+	if (ptr != NULL) {
+		h = (mem_header*)ptr - 1;
+		if (h->mapped) {
+			munmap(h->base, h->len);
+		}
+		else {
+			free(h->base);
+		}
+	}
+}
+
+/**********************************************************/
+/*
+ * Allocates and initializes a new arena, with a first block of the given
+ * number of bytes. Further blocks of at least the same size are allocated as
+ * needed. Returns the new structure, or NULL if error.
+ */
+mem_arena* mem_arena_malloc(size_t size) {
+	mem_arena* a;
+
+	// check parameters
+	if (size == 0) {
+		return NULL;
+	}
+
+	// allocate memory for structure
+	a = (mem_arena*)malloc(sizeof(mem_arena));
+	if (a == NULL) {
+		return NULL;
+	}
+
+	// set default values
+	a->block = NULL;
+	a->block_size = size;
+
+	// allocate first block
+	if (mem_arena_alloc(a, 0, MEM_ALIGN) == NULL) {
+		free(a);
+		return NULL;
+	}
+
+	return a;
+}
+
+/**********************************************************/
+/*
+ * Frees the given arena, and all memory allocated from it.
+ */
+void mem_arena_free(mem_arena* a) {
+	mem_block* b;
+
+	if (a != NULL) {
+		while (a->block != NULL) {
+			b = a->block;
+			a->block = b->next;
+			mem_free(b);
+		}
+		free(a);
+	}
+}
+
+/**********************************************************/
+/*
+ * Allocates the given number of bytes from the given arena, aligned to the
+ * given alignment, which is raised to MEM_ALIGN and must be a power of two.
+ * A new block is allocated if the current block is full. The memory is freed
+ * with the arena. Returns the allocated memory, or NULL if error.
+ */
+void* mem_arena_alloc(mem_arena* a, size_t size, size_t align) {
+	mem_block* b;
+	uintptr_t start;
+	uintptr_t p;
+	size_t len;
+
+	// check parameters
+	if (a == NULL) {
+		return NULL;
+	}
+	if (align < MEM_ALIGN) {
+		align = MEM_ALIGN;
+	}
+	if ((align & (align - 1)) != 0) {
+		return NULL;
+	}
+
+	// aligned memory within the current block
+	b = a->block;
+	if (b != NULL) {
+		start = (uintptr_t)(b + 1);
+		p = (start + b->used + (align - 1)) & ~(uintptr_t)(align - 1);
+		if (p + size <= start + b->size) {
+			b->used = (p + size) - start;
+			return (void*)p;
+		}
+	}
+
+	// new block, large enough to align the memory
+	len = size + align;
+	if (len < a->block_size) {
+		len = a->block_size;
+	}
+	b = (mem_block*)mem_alloc(sizeof(mem_block) + len, MEM_ALIGN);
+	if (b == NULL) {
+		return NULL;
+	}
+	b->next = a->block;
+	b->size = len;
+	b->used = 0;
+	a->block = b;
+
+	// aligned memory at the start of the block
+	start = (uintptr_t)(b + 1);
+	p = (start + (align - 1)) & ~(uintptr_t)(align - 1);
+	b->used = (p + size) - start;
+
+	return (void*)p;
+}
+
+/**********************************************************/
@@ -0,0 +1,26 @@
+#ifndef _MEM_H
+#define _MEM_H
+
+#include <stddef.h>
+
+#define MEM_ALIGN		(size_t)64		// minimum alignment, a cache line and the widest vector
+#define MEM_PAGE		(size_t)4096		// maximum alignment of mapped memory
+#define MEM_HUGE		(size_t)2097152		// size of a huge page, from which memory is mapped
+
+struct mem_block;
+
+// arena of memory freed all at once
+struct mem_arena {
+	struct mem_block* block;	// current block, linked to earlier blocks
+	size_t block_size;	// minimum size of new blocks
+};
+typedef struct mem_arena mem_arena;
+
+void* mem_alloc(size_t size, size_t align);
+void mem_free(void* ptr);
+
+mem_arena* mem_arena_malloc(size_t size);
+void mem_arena_free(mem_arena* a);
+void* mem_arena_alloc(mem_arena* a, size_t size, size_t align);
+
+#endif /* _MEM_H */
@@ -0,0 +1,167 @@
+/*
+ * pool - pool of worker threads
+ *
+ * Provides a fixed number of threads which run the same function on separate
+ * parts of some work. The caller runs the first part itself, and returns once
+ * every part is complete, so the work is done in parallel but the caller sees
+ * it as a single function call. The threads are started once and wait for
+ * work in between, so the pool can be used for many small pieces of work.
+ *
+ * It is the function's responsibility to split the work according to its
+ * index and the number of parts, and to only write to memory of its own part.
+ */
+
+#include <stdio.h>		// NULL
+#include <stdlib.h>		// malloc(), free()
+#include <pthread.h>		// pthread_create(), pthread_join(), pthread_mutex_*(), pthread_cond_*()
+#include "pool.h"
+
+/**********************************************************/
+/*
+ * Runs the part of the given worker thread each time work is made available,
+ * until the pool is freed.
+ */
+static void* pool_worker(void* arg) {
+	pool_thread* t = (pool_thread*)arg;
+	pool* p = t->p;
+	size_t gen;
+
+	pthread_mutex_lock(&p->lock);
+	gen = 0;
+	while (1) {
+
+		// wait for new work
+		while (p->gen == gen && ! p->quit) {
+			pthread_cond_wait(&p->start, &p->lock);
+		}
+		if (p->quit) {
+			break;
+		}
+		gen = p->gen;
+
+		// run part without the lock
+		pthread_mutex_unlock(&p->lock);
+		p->fn(p->arg, t->idx, p->cnt);
+		pthread_mutex_lock(&p->lock);
+
+		// last part to complete
+		p->busy--;
+		if (p->busy == 0) {
+			pthread_cond_signal(&p->done);
+		}
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return NULL;
+}
+
+/**********************************************************/
+/*
+ * Allocates memory and starts a pool which splits work in the given number of
+ * parts, running all but the first part on their own threads. Returns the new
+ * pool, or NULL if error.
+ */
+pool* pool_malloc(int cnt) {
+	pool* p;
+	int i;
+
+	// check parameters
+	if (cnt <= 0) {
+		return NULL;
+	}
+
+	// allocate pool
+	p = (pool*)malloc(sizeof(pool));
+	if (p == NULL) {
+		return NULL;
+	}
+
+	// allocate threads
+	p->t = (pool_thread*)malloc(sizeof(pool_thread) * cnt);
+	if (p->t == NULL) {
+		free(p);
+		return NULL;
+	}
+
+	// set default values
+	p->cnt = 1;
+	p->fn = NULL;
+	p->arg = NULL;
+	p->gen = 0;
+	p->busy = 0;
+	p->quit = 0;
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->start, NULL);
+	pthread_cond_init(&p->done, NULL);
+
+	// start threads, counting the parts which have a thread
+	for (i = 1; i < cnt; i++) {
+		p->t[i].p = p;
+		p->t[i].idx = i;
+		if (pthread_create(&p->t[i].thread, NULL, pool_worker, &p->t[i]) != 0) {
+			pool_free(p);
+			return NULL;
+		}
+		p->cnt++;
+	}
+
+	return p;
+}
+
+/**********************************************************/
+/*
+ * Ends the threads of the given pool and frees all memory associated with it.
+ */
+void pool_free(pool* p) {
+	int i;
+
+	// check parameters
+	if (p == NULL) {
+		return;
+	}
+
+	// end threads
+	pthread_mutex_lock(&p->lock);
+	p->quit = 1;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+	for (i = 1; i < p->cnt; i++) {
+		pthread_join(p->t[i].thread, NULL);
+	}
+
+	pthread_cond_destroy(&p->done);
+	pthread_cond_destroy(&p->start);
+	pthread_mutex_destroy(&p->lock);
+	free(p->t);
+	free(p);
+}
+
+/**********************************************************/
+/*
+ * Runs the given function with the given argument once for each part of the
+ * pool, passing the index of the part and the number of parts. The first part
+ * is run by the caller. Returns once every part is complete.
+ */
+void pool_run(pool* p, void (*fn)(void* arg, int idx, int cnt), void* arg) {
+
+	// make work available to the threads
+	pthread_mutex_lock(&p->lock);
+	p->fn = fn;
+	p->arg = arg;
+	p->busy = p->cnt - 1;
+	p->gen++;
+	pthread_cond_broadcast(&p->start);
+	pthread_mutex_unlock(&p->lock);
+
+	// run first part
+	fn(arg, 0, p->cnt);
+
+	// wait for the other parts
+	pthread_mutex_lock(&p->lock);
+	while (p->busy > 0) {
+		pthread_cond_wait(&p->done, &p->lock);
+	}
+	pthread_mutex_unlock(&p->lock);
+}
+
+/**********************************************************/
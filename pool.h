@@ -0,0 +1,35 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <pthread.h>
+
+struct pool;
+
+// worker thread of a pool
+struct pool_thread {
+	struct pool* p;		// pool of the thread
+	int idx;		// index of the part run by the thread
+	pthread_t thread;	// thread
+};
+typedef struct pool_thread pool_thread;
+
+// pool of worker threads
+struct pool {
+	int cnt;		// number of parts, including the part of the caller
+	pool_thread* t;		// threads, one less than the number of parts
+	pthread_mutex_t lock;	// lock of the fields below
+	pthread_cond_t start;	// signaled when work is available
+	pthread_cond_t done;	// signaled when the last thread completes its part
+	void (*fn)(void* arg, int idx, int cnt);	// function to run
+	void* arg;		// argument of the function
+	size_t gen;		// number of times work was made available
+	int busy;		// number of threads still running their part
+	int quit;		// flag to end the threads
+};
+typedef struct pool pool;
+
+pool* pool_malloc(int cnt);
+void pool_free(pool* p);
+void pool_run(pool* p, void (*fn)(void* arg, int idx, int cnt), void* arg);
+
+#endif /* _POOL_H */
@@ -0,0 +1,232 @@
+/*
+ * range - list of ranges to compare
+ *
+ * Provides a list of ranges of positions, given as OFFSET:LENGTH pairs on the
+ * command line or in a file, so that many regions of the same files can be
+ * compared by a single invocation. The ranges are sorted by position and
+ * overlapping or adjacent ranges are coalesced, so that the files only ever
+ * move forward from one range to the next and no byte is compared twice.
+ */
+
+#include <stdio.h>		// NULL, fopen(), getline(), fclose()
+#include <stdlib.h>		// malloc(), realloc(), free(), qsort()
+#include <string.h>		// strchr(), strspn()
+#include "value.h"
+#include "range.h"
+
+#define RANGE_SEPARATORS	", \t\r\n"	// characters between pairs
+
+/**********************************************************/
+/*
+ * Compares ranges by increasing position, then by increasing end, for
+ * qsort().
+ */
+static int range_cmp(const void* a, const void* b) {
+	const range* ra = (const range*)a;
+	const range* rb = (const range*)b;
+
+	if (ra->pos != rb->pos) {
+		return ra->pos > rb->pos ? 1 : -1;
+	}
+	if (ra->end != rb->end) {
+		return ra->end > rb->end ? 1 : -1;
+	}
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Allocates and initializes a new empty list of ranges. Returns the new
+ * structure, or NULL if error.
+ */
+range_list* range_malloc(void) {
+	range_list* rl;
+
+	// allocate memory for structure
+	rl = (range_list*)malloc(sizeof(range_list));
+	if (rl == NULL) {
+		return NULL;
+	}
+
+	// allocate ranges
+	rl->r = (range*)malloc(RANGE_SIZE * sizeof(range));
+	if (rl->r == NULL) {
+		free(rl);
+		return NULL;
+	}
+
+	// set default values
+	rl->cnt = 0;
+	rl->size = RANGE_SIZE;
+
+	return rl;
+}
+
+/**********************************************************/
+/*
+ * Frees the memory used by the given list of ranges.
+ */
+void range_free(range_list* rl) {
+
+	if (rl != NULL) {
+		free(rl->r);
+		free(rl);
+	}
+}
+
+/**********************************************************/
+/*
+ * Adds the range of the given length at the given position, limited to the
+ * maximum position. Empty ranges are not added. Returns 0 if successful, or -1
+ * if error.
+ */
+int range_add(range_list* rl, size_t pos, size_t len) {
+	range* r;
+
+	// check parameters
+	if (rl == NULL) {
+		return -1;
+	}
+
+	// nothing to compare
+	if (len == 0) {
+		return 0;
+	}
+
+	// double the number of ranges when full
+	if (rl->cnt >= rl->size) {
+		r = (range*)realloc(rl->r, rl->size * 2 * sizeof(range));
+		if (r == NULL) {
+			return -1;
+		}
+		rl->r = r;
+		rl->size *= 2;
+	}
+
+	// end position, which must not overflow
+	rl->r[rl->cnt].pos = pos;
+	rl->r[rl->cnt].end = pos + len;
+	if (rl->r[rl->cnt].end < pos) {
+		rl->r[rl->cnt].end = (size_t)-1;
+	}
+	rl->cnt++;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Adds the ranges of the given string of OFFSET:LENGTH pairs, separated by
+ * commas or whitespace. Returns 0 if successful, or -1 if the string is not a
+ * valid list of ranges or if error.
+ */
+int range_parse(range_list* rl, char* str) {
+	char* end;
+	size_t pos;
+	size_t len;
+
+	// check parameters
+	if (rl == NULL || str == NULL) {
+		return -1;
+	}
+
+	// loop through pairs
+	str += strspn(str, RANGE_SEPARATORS);
+	while (*str != '\0') {
+		if (value_parse(str, &end, &pos) < 0 || *end != ':') {
+			return -1;
+		}
+		if (value_parse(end + 1, &end, &len) < 0) {
+			return -1;
+		}
+		if (*end != '\0' && strchr(RANGE_SEPARATORS, *end) == NULL) {
+			return -1;
+		}
+		if (range_add(rl, pos, len) < 0) {
+			return -1;
+		}
+
+		// next pair
+		str = end + strspn(end, RANGE_SEPARATORS);
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Adds the ranges of the file at the given path, which holds OFFSET:LENGTH
+ * pairs the same as range_parse(), with comments from # to the end of a line.
+ * Returns 0 if successful, or -1 if the file is not a valid list of ranges or
+ * if error.
+ */
+int range_read(range_list* rl, char* path) {
+	char* line;
+	size_t size;
+	char* comment;
+	FILE* fp;
+	int ret;
+
+	// check parameters
+	if (rl == NULL || path == NULL) {
+		return -1;
+	}
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		return -1;
+	}
+
+	// loop through lines, of any length so that no pair is split
+	line = NULL;
+	size = 0;
+	ret = 0;
+	while (ret == 0 && getline(&line, &size, fp) >= 0) {
+		comment = strchr(line, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+		ret = range_parse(rl, line);
+	}
+	if (ret == 0 && ! feof(fp)) {
+		ret = -1;
+	}
+
+	free(line);
+	fclose(fp);
+
+	return ret;
+}
+
+/**********************************************************/
+/*
+ * Sorts the ranges by position, and coalesces overlapping or adjacent ranges
+ * into a single range.
+ */
+void range_sort(range_list* rl) {
+	size_t i;
+	size_t n;
+
+	// check parameters
+	if (rl == NULL || rl->cnt == 0) {
+		return;
+	}
+
+	qsort(rl->r, rl->cnt, sizeof(range), range_cmp);
+
+	// extend the last range kept, or keep the next range
+	n = 0;
+	for (i = 1; i < rl->cnt; i++) {
+		if (rl->r[i].pos <= rl->r[n].end) {
+			if (rl->r[i].end > rl->r[n].end) {
+				rl->r[n].end = rl->r[i].end;
+			}
+		}
+		else {
+			rl->r[++n] = rl->r[i];
+		}
+	}
+	rl->cnt = n + 1;
+}
+
+/**********************************************************/
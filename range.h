@@ -0,0 +1,31 @@
+#ifndef _RANGE_H
+#define _RANGE_H
+
+#include <stddef.h>
+
+#define RANGE_SIZE		64		// initial number of ranges of a list
+#define RANGE_FILE		'@'		// prefix of a file of ranges
+
+// range of positions to compare
+struct range {
+	size_t pos;		// starting position
+	size_t end;		// ending position, after the last byte
+};
+typedef struct range range;
+
+// list of ranges
+struct range_list {
+	range* r;		// ranges, sorted and coalesced by range_sort()
+	size_t cnt;		// number of ranges
+	size_t size;		// number of allocated ranges
+};
+typedef struct range_list range_list;
+
+range_list* range_malloc(void);
+void range_free(range_list* rl);
+int range_add(range_list* rl, size_t pos, size_t len);
+int range_parse(range_list* rl, char* str);
+int range_read(range_list* rl, char* path);
+void range_sort(range_list* rl);
+
+#endif /* _RANGE_H */
@@ -6,19 +6,29 @@
  * capability to read data from a file into a structured buffer.
  */
 
+#define _GNU_SOURCE		// O_DIRECT
 #include <stdio.h>              // NULL
 #include <stdlib.h>		// malloc(), free()
+#include <stdint.h>		// uintptr_t
 #include <string.h>		// memmove()
+#include <errno.h>		// errno
 #include <unistd.h>		// read(), close(), lseek(), stat()
-#include <fcntl.h>		// open()
+#include <fcntl.h>		// open(), fcntl(), posix_fadvise(), readahead(), splice()
 #include <sys/stat.h>		// open(), stat()
 #include <sys/types.h>		// open(), lseek(), stat()
+#include <sys/ioctl.h>		// ioctl()
+#ifdef __linux__
+#include <linux/fs.h>		// BLKGETSIZE64
+#endif
+#include "mem.h"
 #include "sbuf.h"
+#include "sbuf_zip.h"
+#include "sbuf_map.h"
 
 /**********************************************************/
 /*
- * Allocates memory and initializes a new structured buffer. Returns the new
- * structure, or NULL if error.
+ * Allocates memory and initializes a new structured buffer. The buffer is
+ * aligned to MEM_ALIGN. Returns the new structure, or NULL if error.
  */
 sbuf* sbuf_malloc(size_t buf_size) {
 	sbuf* sb;
@@ -35,7 +45,7 @@ sbuf* sbuf_malloc(size_t buf_size) {
 	}
 
 	// allocate memory for buffer
-	sb->ptr = (unsigned char*)malloc(sizeof(unsigned char) * buf_size);
+	sb->ptr = (unsigned char*)mem_alloc(sizeof(unsigned char) * buf_size, MEM_ALIGN);
 	if (sb->ptr == NULL) {
 		free(sb);
 		return NULL;
@@ -46,6 +56,96 @@ sbuf* sbuf_malloc(size_t buf_size) {
 	sb->pos = 0;
 //	sb->before = 0;
 	sb->len = 0;
+	sb->base = sb->ptr;
+	sb->align = 1;
+
+	return sb;
+}
+
+/**********************************************************/
+/*
+ * Allocates memory and initializes a new structured buffer for direct I/O.
+ * The size is rounded up to the given alignment, plus one more aligned block
+ * so that a full aligned read always fits after a partial line. The data is
+ * kept so that its end is always aligned, which is where the next read is
+ * stored. Returns the new structure, or NULL if error.
+ */
+sbuf* sbuf_malloc_aligned(size_t buf_size, size_t align) {
+	sbuf* sb;
+
+	// check parameters
+	if (buf_size == 0 || align == 0) {
+		return NULL;
+	}
+
+	// round up size
+	buf_size += (align - (buf_size % align)) % align;
+	buf_size += align;
+
+	// allocate memory for structure
+	sb = (sbuf*)malloc(sizeof(sbuf));
+	if (sb == NULL) {
+		return NULL;
+	}
+
+	// allocate memory for buffer, leaving room to align the end of the data
+	sb->base = (unsigned char*)mem_alloc(buf_size + align, align);
+	if (sb->base == NULL) {
+		free(sb);
+		return NULL;
+	}
+
+	// set default values
+	sb->ptr = sb->base;
+	sb->align = align;
+	sb->size = buf_size;
+	sb->pos = 0;
+	sb->len = 0;
+
+	return sb;
+}
+
+/**********************************************************/
+/*
+ * Allocates a new structured buffer and its buffer from the given arena, next
+ * to the buffers of the other files. If align is greater than 1, the buffer
+ * is set up for direct I/O the same way as with sbuf_malloc_aligned().
+ * The buffer is freed with the arena, not with sbuf_free(). Returns the new
+ * structure, or NULL if error.
+ */
+sbuf* sbuf_malloc_arena(mem_arena* a, size_t buf_size, size_t align) {
+	sbuf* sb;
+	size_t len;
+
+	// check parameters
+	if (a == NULL || buf_size == 0 || align == 0) {
+		return NULL;
+	}
+
+	// round up size, leaving room to align the end of the data
+	len = buf_size;
+	if (align > 1) {
+		buf_size += (align - (buf_size % align)) % align;
+		buf_size += align;
+		len = buf_size + align;
+	}
+
+	// allocate memory for structure and buffer
+	sb = (sbuf*)mem_arena_alloc(a, sizeof(sbuf), MEM_ALIGN);
+	if (sb == NULL) {
+		return NULL;
+	}
+	sb->base = (unsigned char*)mem_arena_alloc(a, len, align);
+	if (sb->base == NULL) {
+		return NULL;
+	}
+
+	// set default values
+	sb->ptr = sb->base;
+	sb->align = align;
+	sb->size = buf_size;
+	sb->pos = 0;
+	sb->len = 0;
 
 	return sb;
 }
@@ -58,8 +158,8 @@ void sbuf_free(sbuf* sb) {
 
 	if (sb != NULL) {
 		// free buffer
-		if (sb->ptr != NULL) {
-			free(sb->ptr);
+		if (sb->base != NULL) {
+			mem_free(sb->base);
 		}
 
 		// free structure
@@ -338,6 +438,7 @@ size_t sbuf_len(sbuf* sb, size_t pos) {
  */
 int sbuf_reduce(sbuf* sb, size_t pos) {
 	size_t rbytes;
+	unsigned char* dst;
 
 	// check parameters
 	if (sb == NULL) {
@@ -354,8 +455,11 @@ int sbuf_reduce(sbuf* sb, size_t pos) {
 		rbytes = pos - sb->pos;
 
 		// buffer is bigger, shift data in buffer
+		// keeping the end of the data aligned
 		if (sb->len > rbytes) {
-			memmove(sb->ptr, sb->ptr + rbytes, sb->len - rbytes);
+			dst = sb->base + (sb->align - ((sb->len - rbytes) % sb->align)) % sb->align;
+			memmove(dst, sb->ptr + rbytes, sb->len - rbytes);
+			sb->ptr = dst;
 			sb->pos += rbytes;
 			sb->len -= rbytes;
 		}
@@ -363,6 +467,7 @@ int sbuf_reduce(sbuf* sb, size_t pos) {
 		// buffer is same size or smaller, empty entire buffer
 		// but set position to current position plus current length
 		else if (sb->len <= rbytes) {
+			sb->ptr = sb->base;
 			sb->pos += sb->len;
 			sb->len = 0;
 		}
@@ -371,6 +476,31 @@ int sbuf_reduce(sbuf* sb, size_t pos) {
 	return 0;
 }
 
+/**********************************************************/
+/*
+ * Initializes the given file structure, which is not open.
+ */
+static void sfile_init(sfile* sf) {
+
+	// initialize file structure
+	sf->fd = -1;
+	sf->eof = 0;
+	sf->size = -1;
+	sf->start_pos = 0;
+	sf->bytes_read = 0;
+	sf->offset = 0;
+	sf->direct = 0;
+	sf->advise = 0;
+	sf->drop = 0;
+	sf->ahead = 0;
+	sf->dropped = 0;
+	sf->stop = 0;
+	sf->zip = NULL;
+	sf->pat_len = 0;
+	sf->map = NULL;
+	sf->region = 0;
+}
+
 /**********************************************************/
 /*
  * Allocates memory and initializes a new file structure. Returns the new
@@ -385,11 +515,27 @@ sfile* sfile_malloc(void) {
 		return NULL;
 	}
 
-	// initialize file structure
-	sf->fd = -1;
-	sf->eof = 0;
-	sf->start_pos = 0;
-	sf->bytes_read = 0;
+	sfile_init(sf);
+
+	return sf;
+}
+
+/**********************************************************/
+/*
+ * Allocates a new file structure from the given arena, next to the structures
+ * of the other files. The structure is freed with the arena, not with
+ * sfile_free(). Returns the new structure, or NULL if error.
+ */
+sfile* sfile_malloc_arena(mem_arena* a) {
+	sfile* sf;
+
+	// allocate memory for structure
+	sf = (sfile*)mem_arena_alloc(a, sizeof(sfile), MEM_ALIGN);
+	if (sf == NULL) {
+		return NULL;
+	}
+
+	sfile_init(sf);
 
 	return sf;
 }
@@ -405,13 +551,88 @@ void sfile_free(sfile* sf) {
 	}
 }
 
+/**********************************************************/
+/*
+ * Sets the pattern of the given virtual file from the given string of pairs
+ * of hexadecimal digits, such as "00" or "deadbeef". Returns 0 if successful,
+ * or -1 if the string is not a valid pattern.
+ */
+static int sfile_pattern_open(sfile* sf, char* str) {
+	size_t len;
+	size_t i;
+	int j;
+	int c;
+	int v;
+
+	// whole bytes, up to the maximum
+	len = strlen(str);
+	if (len == 0 || len % 2 != 0 || len / 2 > SFILE_PATTERN_MAX) {
+		return -1;
+	}
+
+	// loop through hexadecimal digits
+	for (i = 0; i < len / 2; i++) {
+		sf->pat[i] = 0;
+		for (j = 0; j < 2; j++) {
+			c = str[(i * 2) + j];
+			if (c >= '0' && c <= '9') {
+				v = c - '0';
+			}
+			else if (c >= 'a' && c <= 'f') {
+				v = c - 'a' + 10;
+			}
+			else if (c >= 'A' && c <= 'F') {
+				v = c - 'A' + 10;
+			}
+			else {
+				return -1;
+			}
+			sf->pat[i] = (sf->pat[i] << 4) | v;
+		}
+	}
+	sf->pat_len = len / 2;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Generates len bytes of the pattern of the given virtual file into the given
+ * memory, continuing the pattern at the current offset of the file. The first
+ * period of the pattern is copied byte by byte, then the periods already
+ * generated are copied in doubling amounts, so that a whole buffer only takes
+ * a few copies.
+ */
+static void sfile_pattern_read(sfile* sf, unsigned char* dst, size_t len) {
+	size_t phase;
+	size_t done;
+	size_t n;
+
+	// first period, starting at the offset
+	phase = sf->offset % sf->pat_len;
+	for (done = 0; done < len && done < sf->pat_len; done++) {
+		dst[done] = sf->pat[(phase + done) % sf->pat_len];
+	}
+
+	// double the whole periods already generated
+	while (done < len) {
+		n = (len - done < done ? len - done : done);
+		memcpy(dst + done, dst, n);
+		done += n;
+	}
+}
+
 /**********************************************************/
 /*
  * Opens the file at the given path and stores the file descriptor in the given
- * structure. Returns 0 if successful, or < 0 if error.
+ * structure. A path starting with SFILE_PATTERN is not opened, but sets up a
+ * virtual file repeating the pattern that follows without end. A region of a
+ * file, given as FILE@OFFSET+LENGTH, is read from a mapping of the file
+ * shared with its other regions. Returns 0 if successful, or < 0 if error.
  */
 int sfile_open(sfile* sf, char* path) {
 	struct stat buf;
+	int flags;
 
 	// check parameters
 	if (sf == NULL || path == NULL) {
@@ -424,9 +645,34 @@ int sfile_open(sfile* sf, char* path) {
 	}
 
 
+	// virtual file repeating a pattern, nothing is opened
+	if (strncmp(path, SFILE_PATTERN, strlen(SFILE_PATTERN)) == 0) {
+		if (sfile_pattern_open(sf, path + strlen(SFILE_PATTERN)) < 0) {
+			return -1;
+		}
+		sf->direct = 0;
+		sf->eof = 0;
+		sf->bytes_read = 0;
+		sf->offset = 0;
+		return 0;
+	}
+
+	// region of a file, read from the mapping of the whole file
+	if (sfile_map_detect(path)) {
+		if (sfile_map_open(sf, path) < 0) {
+			return -1;
+		}
+		sf->direct = 0;
+		sf->eof = 0;
+		sf->bytes_read = 0;
+		sf->offset = 0;
+		return 0;
+	}
+
 	// STDIN
 	if (strcmp(path, "-") == 0) {
 		sf->fd = fileno(stdin);
+		sf->direct = 0;
 	}
 	// file
 	else {
@@ -441,6 +687,37 @@ int sfile_open(sfile* sf, char* path) {
 
 		// open file
 		sf->fd = open(path, O_RDONLY, 0666);
+
+		// file is read sequentially, including a compressed file
+		if (sf->fd >= 0) {
+			posix_fadvise(sf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+
+		// decompress compressed file on a separate thread
+		if (sf->fd >= 0 && sfile_zip_open(sf) < 0) {
+			close(sf->fd);
+			sf->fd = -1;
+		}
+
+		// direct I/O, only for uncompressed regular files and block
+		// devices, and only if the file system supports it
+		if (sf->fd >= 0 && sf->direct) {
+			sf->direct = 0;
+#ifdef O_DIRECT
+			if (sf->zip == NULL && (S_ISREG(buf.st_mode) || S_ISBLK(buf.st_mode))) {
+				flags = fcntl(sf->fd, F_GETFL);
+				if (flags >= 0 && fcntl(sf->fd, F_SETFL, flags | O_DIRECT) == 0) {
+					sf->direct = 1;
+				}
+			}
+#endif
+		}
+
+		// read ahead and drop pages for uncompressed regular files and
+		// block devices
+		if (sf->fd >= 0 && sf->zip == NULL && (S_ISREG(buf.st_mode) || S_ISBLK(buf.st_mode))) {
+			sf->advise = 1;
+		}
 	}
 
 	// invalid file
@@ -448,37 +725,143 @@ int sfile_open(sfile* sf, char* path) {
 		return sf->fd;
 	}
 
+	// size of file, so that EOF is known without another read, except for
+	// files that report no size (such as those of /proc)
+	sf->size = sfile_size(sf);
+	if (sf->size == 0) {
+		sf->size = -1;
+	}
+
 	// reset values
 	sf->eof = 0;
 	sf->bytes_read = 0;
+	sf->offset = 0;
+	sf->ahead = 0;
+	sf->dropped = 0;
 
 	return 0;
 }
 
 /**********************************************************/
 /*
- * Closes the given file. Return 0 if successful, or < 0 on error.
+ * Closes the given file. The file can be closed more than once, but only the
+ * first call closes the file descriptor. For a compressed file, also waits for
+ * the decompression thread to stop. Return 0 if successful, or < 0 on error.
  */
 int sfile_close(sfile* sf) {
+	int fd;
+	int ret;
 
 	// check parameters
 	if (sf == NULL) {
 		return -1;
 	}
 
+	// virtual file, nothing to close
+	if (sf->pat_len > 0) {
+		return 0;
+	}
+
+	// region, the file is unmapped and closed with its last region
+	if (sf->map != NULL) {
+		return sfile_map_close(sf);
+	}
+
+	// already closed
 	if (sf->fd < 0) {
-		return -1;
+		return 0;
 	}
 
-	return close(sf->fd);
+	// drop remaining pages that were read or read ahead
+	if (sf->advise && sf->drop && ! sf->direct) {
+		if (sf->ahead < sf->offset) {
+			sf->ahead = sf->offset;
+		}
+		if (sf->ahead > sf->dropped) {
+			posix_fadvise(sf->fd, sf->dropped, sf->ahead - sf->dropped, POSIX_FADV_DONTNEED);
+		}
+	}
+
+	// mark as closed
+	fd = sf->fd;
+	sf->fd = -1;
+
+	ret = close(fd);
+
+	// stop decompression
+	if (sfile_zip_close(sf) < 0) {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+/**********************************************************/
+/*
+ * Switches the given file from direct I/O back to buffered I/O.
+ */
+static void sfile_buffered(sfile* sf) {
+#ifdef O_DIRECT
+	int flags;
+
+	flags = fcntl(sf->fd, F_GETFL);
+	if (flags >= 0) {
+		fcntl(sf->fd, F_SETFL, flags & ~O_DIRECT);
+	}
+#endif
+	sf->direct = 0;
+}
+
+/**********************************************************/
+/*
+ * Gives the kernel hints about the given file after a read. Requests readahead
+ * of the next SFILE_READAHEAD bytes once the read position comes within half
+ * of that of the end of the last request, so that reads are served from the
+ * page cache. If enabled, also drops the pages before the data still held in
+ * the given buffer, once there are at least SFILE_READAHEAD bytes of them, so
+ * that the page cache footprint stays flat. Lines of context are copied into
+ * the cache, so their pages are not needed either. Nothing is read ahead past
+ * the stop offset, so that small ranges only read what they compare.
+ */
+static void sfile_advise(sfile* sf, sbuf* sb) {
+	size_t behind;
+	size_t len;
+
+	// read ahead of the read position, up to the stop offset
+	if (sf->ahead < sf->offset) {
+		sf->ahead = sf->offset;
+	}
+	len = SFILE_READAHEAD;
+	if (sf->stop > 0 && sf->stop < sf->ahead + len) {
+		len = (sf->stop > sf->ahead ? sf->stop - sf->ahead : 0);
+	}
+	if (len > 0 && sf->ahead < sf->offset + (SFILE_READAHEAD / 2)) {
+#ifdef __linux__
+		readahead(sf->fd, sf->ahead, len);
+#else
+		posix_fadvise(sf->fd, sf->ahead, len, POSIX_FADV_WILLNEED);
+#endif
+		sf->ahead += len;
+	}
+
+	// drop pages behind the data in the buffer
+	if (sf->drop) {
+		behind = sf->offset - sb->len;
+		if (behind >= sf->dropped + SFILE_READAHEAD) {
+			posix_fadvise(sf->fd, sf->dropped, behind - sf->dropped, POSIX_FADV_DONTNEED);
+			sf->dropped = behind;
+		}
+	}
 }
 
 /**********************************************************/
 /*
  * Reads data from the given file and appends it to the given buffer. Attempts
  * to read enough data to fill the entire buffer, but can be limited by how
- * much data is actually returned by a single read. Returns the number of bytes
- * read, or 0 if eof, or < 0 if error.
+ * much data is actually returned by a single read. For a file of known size,
+ * EOF is set by the read that reaches the end of the file, so that no further
+ * read is needed to detect it. Returns the number of bytes read, or 0 if eof,
+ * or < 0 if error.
  */
 ssize_t sfile_read(sfile* sf, sbuf* sb) {
 	size_t read_size;
@@ -489,8 +872,9 @@ ssize_t sfile_read(sfile* sf, sbuf* sb) {
 		return 0;
 	}
 
-	// enf-of-file
-	if (sf->eof) {
+	// enf-of-file, or all data of a file of known size was read
+	if (sf->eof || (sf->size >= 0 && sf->offset >= (size_t)sf->size)) {
+		sf->eof = 1;
 		return 0;
 	}
 
@@ -498,6 +882,44 @@ ssize_t sfile_read(sfile* sf, sbuf* sb) {
 	// size of buffer minus current length of data
 	read_size = sb->size - sb->len;
 
+	// virtual file, generate the pattern, which never ends
+	if (sf->pat_len > 0) {
+		if (read_size == 0) {
+			return -1;
+		}
+		sfile_pattern_read(sf, sb->ptr + sb->len, read_size);
+		sb->len += read_size;
+		sf->bytes_read += read_size;
+		sf->offset += read_size;
+		return read_size;
+	}
+
+	// region, copy from the mapping up to the end of the region
+	if (sf->map != NULL) {
+		if (read_size == 0) {
+			return -1;
+		}
+		br = sfile_map_read(sf, sb->ptr + sb->len, read_size);
+		sb->len += br;
+		sf->bytes_read += br;
+		sf->offset += br;
+		if (sf->offset >= (size_t)sf->size) {
+			sf->eof = 1;
+		}
+		return br;
+	}
+
+	// direct I/O reads whole blocks into aligned memory at an aligned
+	// offset, which is no longer possible after a partial block at EOF
+	if (sf->direct) {
+		if (sb->align % SFILE_DIRECT_ALIGN != 0 || (uintptr_t)(sb->ptr + sb->len) % SFILE_DIRECT_ALIGN != 0 || sf->offset % SFILE_DIRECT_ALIGN != 0) {
+			sfile_buffered(sf);
+		}
+		else {
+			read_size -= read_size % SFILE_DIRECT_ALIGN;
+		}
+	}
+
 	// buffer is already full
 	if (read_size == 0) {
 		return -1;
@@ -505,9 +927,27 @@ ssize_t sfile_read(sfile* sf, sbuf* sb) {
 
 	// read from file
 	br = read(sf->fd, sb->ptr + sb->len, read_size);
+
+	// direct I/O is rejected by the file system, read again buffered
+	if (br < 0 && errno == EINVAL && sf->direct) {
+		sfile_buffered(sf);
+		read_size = sb->size - sb->len;
+		br = read(sf->fd, sb->ptr + sb->len, read_size);
+	}
 	if (br > 0) {
 		sb->len += br;
 		sf->bytes_read += br;
+		sf->offset += br;
+
+		// all data of a file of known size was read
+		if (sf->size >= 0 && sf->offset >= (size_t)sf->size) {
+			sf->eof = 1;
+		}
+
+		// page cache hints, not needed for direct I/O
+		if (sf->advise && ! sf->direct) {
+			sfile_advise(sf, sb);
+		}
 	}
 	else if (br == 0) {
 		sf->eof = 1;
@@ -519,24 +959,169 @@ ssize_t sfile_read(sfile* sf, sbuf* sb) {
 	return br;
 }
 
+/**********************************************************/
+/*
+ * Discards up to len bytes from the given file without copying them to user
+ * memory, by splicing them into /dev/null. A pipe (such as STDIN or the output
+ * of a decompression thread) is spliced directly, anything else through an
+ * intermediate pipe. Returns the number of bytes discarded, which is less than
+ * len at EOF or if splice() cannot be used, in which case the rest must be
+ * read.
+ */
+static size_t sfile_splice(sfile* sf, size_t len) {
+	size_t done;
+#ifdef SPLICE_F_MOVE
+	int null;
+	int p[2];
+	int direct;
+	ssize_t n;
+	ssize_t m;
+	ssize_t k;
+
+	done = 0;
+	p[0] = -1;
+	p[1] = -1;
+
+	null = open("/dev/null", O_WRONLY);
+	if (null < 0) {
+		return 0;
+	}
+
+	// assume the file is a pipe
+	direct = 1;
+
+	while (done < len) {
+		n = (len - done > SFILE_READAHEAD ? SFILE_READAHEAD : len - done);
+
+		// splice directly into /dev/null
+		if (direct) {
+			n = splice(sf->fd, NULL, null, NULL, n, SPLICE_F_MOVE);
+
+			// file is not a pipe, use an intermediate pipe
+			if (n < 0 && errno == EINVAL && done == 0) {
+				direct = 0;
+				if (pipe(p) < 0) {
+					break;
+				}
+#ifdef F_SETPIPE_SZ
+				fcntl(p[1], F_SETPIPE_SZ, SFILE_READAHEAD);
+#endif
+				continue;
+			}
+		}
+
+		// splice into intermediate pipe, then drain it into /dev/null
+		else {
+			n = splice(sf->fd, NULL, p[1], NULL, n, SPLICE_F_MOVE);
+			for (m = 0; n > 0 && m < n; m += k) {
+				k = splice(p[0], NULL, null, NULL, n - m, SPLICE_F_MOVE);
+				if (k <= 0) {
+					break;
+				}
+			}
+
+			// data is gone from the file, but the pipe is stuck
+			if (n > 0 && m < n) {
+				done += n;
+				break;
+			}
+		}
+
+		// EOF or error, the rest is read
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		done += n;
+	}
+
+	if (p[0] >= 0) {
+		close(p[0]);
+		close(p[1]);
+	}
+	close(null);
+#else
+	done = 0;
+#endif
+
+	return done;
+}
+
+/**********************************************************/
+/*
+ * Discards up to len bytes of the given file after the data read so far,
+ * without reading them. A file of known size is seeked past them, a region
+ * only moves its offset within the mapping, and anything else is spliced into
+ * /dev/null. The discarded bytes are counted as read. Returns the number of
+ * bytes discarded, which is less than len at EOF or if the data cannot be
+ * discarded, in which case the rest must be read.
+ */
+size_t sfile_skip(sfile* sf, size_t len) {
+	size_t n;
+
+	// check parameters
+	if (sf == NULL || (sf->fd < 0 && sf->pat_len == 0 && sf->map == NULL) || sf->eof) {
+		return 0;
+	}
+
+	// virtual file, nothing to discard
+	if (sf->pat_len > 0) {
+		n = len;
+	}
+
+	// file of known size, seek past the data up to the end of the file
+	else if (sf->size >= 0) {
+		n = 0;
+		if ((size_t)sf->size > sf->offset) {
+			n = (size_t)sf->size - sf->offset;
+		}
+		if (n > len) {
+			n = len;
+		}
+		if (n > 0 && sf->map == NULL && lseek(sf->fd, sf->offset + n, SEEK_SET) < 0) {
+			n = 0;
+		}
+	}
+
+	// STDIN, pipe or compressed file
+	else {
+		n = sfile_splice(sf, len);
+	}
+
+	sf->bytes_read += n;
+	sf->offset += n;
+
+	// all data of a file of known size was discarded
+	if (sf->size >= 0 && sf->offset >= (size_t)sf->size) {
+		sf->eof = 1;
+	}
+
+	return n;
+}
+
 /**********************************************************/
 /*
  * Seeks the given file to the specified position. This function should only be
- * called once immediately after calling sbuf_open(), otherwise the relative
- * position may be incorrectly set. If lseek() cannot be used on the given file
- * (such as STDIN), the position is reached by reading the appropriate amount
- * of data. In this case, the structured buffer is used to hold the data as it
- * is read from the file.
+ * called once immediately after calling sbuf_open(), or by sfile_move() with
+ * an empty buffer, otherwise the relative position may be incorrectly set. If
+ * lseek() cannot be used on the given file (such as STDIN), the position is
+ * reached by reading the appropriate amount of data. In this case, the
+ * structured buffer is used to hold the data as it is read from the file.
+ * With direct I/O, lseek() can only be used for the aligned offset before the
+ * position, and the rest is read the same way.
  */
 int sfile_seek(sfile* sf, sbuf* sb, size_t pos) {
 	off_t off;
 	ssize_t br;
+	size_t skip;
 
 	// check parameters
 	if (sf == NULL || sb == NULL) {
 		return -1;
 	}
-	if (pos == 0) {
+	if (pos == sf->offset) {
 		return 0;
 	}
 
@@ -546,11 +1131,38 @@ int sfile_seek(sfile* sf, sbuf* sb, size_t pos) {
 		exit(1);
 	}
 
-	// seek to position
-	off = lseek(sf->fd, pos, SEEK_SET);
+	// virtual file, the pattern continues at the position, and a region
+	// continues at the position within the mapping
+	if (sf->pat_len > 0 || sf->map != NULL) {
+		sf->offset = pos;
+		sb->pos = pos;
+		return 0;
+	}
+
+	// seek to position, or for direct I/O to the aligned offset before it
+	skip = (sf->direct ? pos % SFILE_DIRECT_ALIGN : 0);
+	off = lseek(sf->fd, pos - skip, SEEK_SET);
+	if (off >= 0) {
+		sf->offset = pos - skip;
+		sf->ahead = sf->offset;
+		sf->dropped = sf->offset;
+		sb->pos = pos - skip;
+	}
+
+	// lseek() doesn't work on STDIN, skip from the current offset without
+	// copying the data if possible, which can only move forward
+	else {
+		if (pos < sf->offset) {
+			return -1;
+		}
+		skip = sfile_splice(sf, pos - sf->offset);
+		sb->pos += skip;
+		sf->offset += skip;
+		skip = pos - sf->offset;
+	}
 
-	// lseek() doesn't work on STDIN
-	if (off < 0) {
+	// read the data up to the position
+	if (skip > 0) {
 
 		// loop reading file
 		while (sb->pos < pos) {
@@ -576,8 +1188,8 @@ int sfile_seek(sfile* sf, sbuf* sb, size_t pos) {
 		}
 
 		// adjust bytes read as if seeking was performed
-		if (sf->bytes_read > pos) {
-			sf->bytes_read -= pos;
+		if (sf->bytes_read > skip) {
+			sf->bytes_read -= skip;
 		}
 		else {
 			sf->bytes_read = 0;
@@ -587,6 +1199,112 @@ int sfile_seek(sfile* sf, sbuf* sb, size_t pos) {
 	return 0;
 }
 
+/**********************************************************/
+/*
+ * Moves the given file to the given offset for another range, once the data
+ * read for the previous range is no longer needed. Data in the buffer from
+ * the offset on is kept, so that a file which cannot be seeked does not need
+ * to read it again, otherwise the buffer is emptied and the file is seeked to
+ * the offset with sfile_seek(). The position of the buffer is in terms of the
+ * file until it is set by the caller. The bytes read are counted again from
+ * the offset, and EOF is cleared unless a file of unknown size has ended.
+ * Returns 0 if successful, or -1 if error.
+ */
+int sfile_move(sfile* sf, sbuf* sb, size_t pos) {
+	size_t start;
+
+	// check parameters
+	if (sf == NULL || sb == NULL) {
+		return -1;
+	}
+
+	// file offset of the data in the buffer
+	start = 0;
+	if (sf->offset > sb->len) {
+		start = sf->offset - sb->len;
+	}
+
+	// only files of unknown size cannot read past their end again
+	if (sf->size >= 0 || sf->pat_len > 0) {
+		sf->eof = 0;
+	}
+	sf->start_pos = 0;
+
+	// offset is within the data of the buffer, keep the rest of the data
+	if (start <= pos && pos < sf->offset) {
+		sb->pos = start;
+		sbuf_reduce(sb, pos);
+		sf->bytes_read = sb->len;
+		return 0;
+	}
+
+	// empty the buffer, then seek
+	sbuf_reduce(sb, sb->pos + sb->len);
+	sb->pos = sf->offset;
+	sf->bytes_read = 0;
+
+	return sfile_seek(sf, sb, pos);
+}
+
+/**********************************************************/
+/*
+ * Returns the size of the given file, or -1 if unknown. The size is known for
+ * regular files and block devices, but not for STDIN, pipes or compressed
+ * files. The size of a region is its length.
+ */
+off_t sfile_size(sfile* sf) {
+	struct stat buf;
+	uint64_t size;
+
+	// region
+	if (sf != NULL && sf->map != NULL) {
+		return sf->size;
+	}
+
+	// check parameters
+	if (sf == NULL || sf->fd < 0 || sf->zip != NULL) {
+		return -1;
+	}
+
+	if (fstat(sf->fd, &buf) != 0) {
+		return -1;
+	}
+
+	// regular file
+	if (S_ISREG(buf.st_mode)) {
+		return buf.st_size;
+	}
+
+#ifdef BLKGETSIZE64
+	// block device
+	if (S_ISBLK(buf.st_mode) && ioctl(sf->fd, BLKGETSIZE64, &size) == 0) {
+		return (off_t)size;
+	}
+#endif
+
+	return -1;
+}
+
+/**********************************************************/
+/*
+ * Gets the status of the given file, or for a region of the whole mapped file.
+ * Returns 0 if successful, or -1 if error, including for virtual files.
+ */
+int sfile_stat(sfile* sf, struct stat* buf) {
+
+	// region
+	if (sf != NULL && sf->map != NULL) {
+		return sfile_map_stat(sf, buf);
+	}
+
+	// check parameters
+	if (sf == NULL || sf->fd < 0 || buf == NULL) {
+		return -1;
+	}
+
+	return fstat(sf->fd, buf);
+}
+
 /**********************************************************/
 /*
  * Shifts the position in the given file and structured buffer by the given
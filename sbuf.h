@@ -1,24 +1,58 @@
 #ifndef _SBUF_H
 #define _SBUF_H
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "mem.h"
+
+// alignment of buffers, offsets and sizes for direct I/O
+#define SFILE_DIRECT_ALIGN	(size_t)4096
+
+// amount of data to read ahead, or to drop from the page cache at once
+#define SFILE_READAHEAD		(size_t)4194304
+
+// prefix of a virtual file repeating a pattern of hexadecimal bytes
+#define SFILE_PATTERN		"pattern:"
+#define SFILE_PATTERN_MAX	64	// maximum number of bytes of a pattern
+
 struct sbuf {
 	unsigned char* ptr;	// pointer to buffer
 	size_t size;		// maximum size of buffer (should not change)
 	size_t pos;		// position of buffer
 //	size_t before;		// number of null bytes before data
 	size_t len;		// length of actual data in buffer
+	unsigned char* base;	// allocated memory, ptr is within the first align bytes
+	size_t align;		// alignment of the end of the data (1 if unaligned)
 };
 typedef struct sbuf sbuf;
 
+struct sfile_zip;
+struct sfile_map;
+
 struct sfile {
 	int fd;
 	int eof;		// flag to mark end-of-file
+	off_t size;		// size of file, or -1 if unknown
 	size_t start_pos;	// starting position (for calculating length)
 	size_t bytes_read;	// total bytes read
+	size_t offset;		// file offset of the next read
+	int direct;		// flag to use direct I/O, cleared if not possible
+	int advise;		// flag to give the kernel access hints
+	int drop;		// flag to drop pages from the page cache once read
+	size_t ahead;		// file offset up to which readahead was requested
+	size_t dropped;		// file offset up to which pages were dropped
+	size_t stop;		// file offset past which no data is needed, or 0 if unknown
+	struct sfile_zip* zip;	// decompression state (compressed files only)
+	unsigned char pat[SFILE_PATTERN_MAX];	// pattern repeated by a virtual file
+	size_t pat_len;		// number of bytes of the pattern (virtual files only)
+	struct sfile_map* map;	// mapping shared with other regions (regions only)
+	size_t region;		// offset of the region in the mapped file
 };
 typedef struct sfile sfile;
 
 sbuf* sbuf_malloc(size_t buf_size);
+sbuf* sbuf_malloc_aligned(size_t buf_size, size_t align);
+sbuf* sbuf_malloc_arena(mem_arena* a, size_t buf_size, size_t align);
 void sbuf_free(sbuf* sb);
 
 size_t sbuf_avail(sbuf* sb, size_t pos);
@@ -31,13 +65,18 @@ size_t sbuf_len(sbuf* sb, size_t pos);
 int sbuf_reduce(sbuf* sb, size_t pos);
 
 sfile* sfile_malloc(void);
+sfile* sfile_malloc_arena(mem_arena* a);
 void sfile_free(sfile* sf);
 
 int sfile_open(sfile* sf, char* name);
 int sfile_close(sfile* sf);
 ssize_t sfile_read(sfile* sf, sbuf* sb);
 int sfile_seek(sfile* sf, sbuf* sb, size_t pos);
+int sfile_move(sfile* sf, sbuf* sb, size_t pos);
+size_t sfile_skip(sfile* sf, size_t len);
 int sfile_shift(sfile* sf, sbuf* sb, size_t len);
 int sfile_eoo(sfile* sf, sbuf* sb, size_t pos);
+off_t sfile_size(sfile* sf);
+int sfile_stat(sfile* sf, struct stat* buf);
 
 #endif /* _SBUF_H */
@@ -10,6 +10,7 @@
 #include <stdlib.h>		// malloc(), free()
 #include <string.h>		// memcpy()
 #include "llq.h"
+#include "mem.h"
 #include "sbuf.h"
 #include "sbuf_cache.h"
 
@@ -27,6 +28,10 @@ sbuf_cache* sbuf_cache_malloc(size_t max_buf_len) {
 		return NULL;
 	}
 
+	// initialize lists
+	llq_list_init(&cache->active);
+	llq_list_init(&cache->inactive);
+
 	// set the maximum buffer length available to each node
 	cache->max_buf_len = max_buf_len;
 
@@ -82,7 +87,7 @@ llq_node* sbuf_cache_node_malloc(size_t size) {
 	}
 
 	// allocate actual buffer
-	obj->ptr = (unsigned char*)malloc(sizeof(unsigned char) * size);
+	obj->ptr = (unsigned char*)mem_alloc(sizeof(unsigned char) * size, MEM_ALIGN);
 	if (obj->ptr == NULL) {
 		free(obj);
 		free(node);
@@ -93,6 +98,8 @@ llq_node* sbuf_cache_node_malloc(size_t size) {
 	obj->size = size;
 	obj->pos = 0;
 	obj->len = 0;
+	obj->base = obj->ptr;
+	obj->align = 1;
 
 	// initialize
 	llq_node_init(node, obj);
@@ -125,8 +132,8 @@ int sbuf_cache_node_free(llq_node* node) {
 	if (obj != NULL) {
 
 		// free buffer
-		if (obj->ptr != NULL) {
-			free(obj->ptr);
+		if (obj->base != NULL) {
+			mem_free(obj->base);
 		}
 
 		// free object
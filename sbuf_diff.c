@@ -7,6 +7,8 @@
 
 #include <stdio.h>              // NULL
 #include <stdlib.h>		// malloc(), free()
+#include <string.h>		// memcmp(), memset()
+#include "mem.h"
 #include "sbuf.h"
 #include "sbuf_diff.h"
 #include "llq.h"
@@ -19,7 +21,6 @@
  * new set of lines. Returns 0 if successful, or -1 if error.
  */
 int sbuf_diff_init(sbuf_diff* d) {
-	size_t i;
 
 	// check parameters
 	if (d == NULL) {
@@ -29,11 +30,9 @@ int sbuf_diff_init(sbuf_diff* d) {
 	// set default values
 	d->pos = 0;
 	d->cnt = 0;
-	for (i = 0; i < d->width; i++) {
-		d->cmp[i] = 0;
-		d->sub->ptr[i] = 0;
-		d->null->ptr[i] = 0;
-	}
+	memset(d->cmp, 0, sizeof(uint64_t) * d->words);
+	memset(d->null, 0, sizeof(uint64_t) * d->words);
+	memset(d->sub->ptr, 0, d->width);
 	d->nbd = 0;
 
 	return 0;
@@ -55,9 +54,10 @@ sbuf_diff* sbuf_diff_malloc(size_t width) {
 
 	// set the width in the structure
 	d->width = width;
+	d->words = (width + 63) / 64;
 
-	// allocate memory for boolean flags
-	d->cmp = (unsigned char*)malloc(sizeof(unsigned char) * width);
+	// allocate memory for difference bitset
+	d->cmp = (uint64_t*)mem_alloc(sizeof(uint64_t) * d->words, MEM_ALIGN);
 	if (d->cmp == NULL) {
 		free(d);
 		return NULL;
@@ -66,16 +66,16 @@ sbuf_diff* sbuf_diff_malloc(size_t width) {
 	// allocate memory for subtraction buffer
 	d->sub = sbuf_malloc(width);
 	if (d->sub == NULL) {
-		free(d->cmp);
+		mem_free(d->cmp);
 		free(d);
 		return NULL;
 	}
 
-	// allocate memory for subtraction buffer
-	d->null = sbuf_malloc(width);
+	// allocate memory for NULL bitset
+	d->null = (uint64_t*)mem_alloc(sizeof(uint64_t) * d->words, MEM_ALIGN);
 	if (d->null == NULL) {
-		free(d->sub);
-		free(d->cmp);
+		sbuf_free(d->sub);
+		mem_free(d->cmp);
 		free(d);
 		return NULL;
 	}
@@ -95,19 +95,19 @@ void sbuf_diff_free(sbuf_diff* d) {
 
 	if (d != NULL) {
 
-		// free null buffer
+		// free null bitset
 		if (d->null != NULL) {
-			free(d->null);
+			mem_free(d->null);
 		}
 
 		// free substraction buffer
 		if (d->sub != NULL) {
-			free(d->sub);
+			sbuf_free(d->sub);
 		}
 
-		// free comparison buffer
+		// free difference bitset
 		if (d->cmp != NULL) {
-			free(d->cmp);
+			mem_free(d->cmp);
 		}
 
 		// free difference structure
@@ -117,52 +117,43 @@ void sbuf_diff_free(sbuf_diff* d) {
 
 /**********************************************************/
 /*
- * Compares two buffers at the given position and length and updates the given
- * difference structure to indicate which bytes were different, according to
- * the given word size.
+ * Compares the words of two buffers starting at the given index of the line,
+ * one byte at a time, for words which may include NULL bytes or extend past
+ * the given length. Each word is assembled in the byte order of the given word
+ * comparator, and its difference is stored in the subtraction buffer in the
+ * same byte order. Only the bits of the mask of the word comparator are
+ * compared and subtracted. Whole words without NULL bytes are compared within
+ * the tolerance of the word comparator, if any, and other words exactly.
  */
-int sbuf_diff_cmp(sbuf* sb1, sbuf* sb2, size_t pos, size_t len, sbuf_diff* d, size_t word_size) {
-	size_t i;
+static void sbuf_diff_cmp_bytes(sbuf* sb1, sbuf* sb2, size_t pos, size_t i, size_t len, sbuf_diff* d, sbuf_diff_word* w) {
 	size_t j;
+	size_t s;
 	size_t val1;
 	size_t val2;
 	size_t vald;
 	int diff;
+	int whole;
 	unsigned char* ch1;
 	unsigned char* ch2;
 
-	// check parameters
-	if (sb1 == NULL || sb2 == NULL) {
-		return -1;
-	}
-	if (d == NULL) {
-		return -1;
-	}
-
-	// save position
-	d->pos = pos;
-
-	// copy position/length to subtraction buffer
-	d->sub->pos = pos;
-	d->sub->len = len;
-
 	// loop through len bytes according to word size
-	for (i = 0; i < len; i += word_size) {
+	for (; i < len; i += w->size) {
 
 		// initialize values
 		val1 = 0;
 		val2 = 0;
 		diff = 0;
+		whole = 1;
 
 		// loop through word size, limited by len
-		for (j = 0; j < word_size; j++) {
+		for (j = 0; j < w->size; j++) {
 
-			// shift existing values by one byte
-			val1 <<= 8;
-			val2 <<= 8;
+			// bit position of the byte in the word
+			s = w->little ? (8 * j) : (8 * (w->size - 1 - j));
 
-			// past len, skip (but continue shift above)
+			// past len, skip
 			if ((i + j) >= len) {
+				whole = 0;
 				continue;
 			}
 
@@ -173,18 +164,21 @@ int sbuf_diff_cmp(sbuf* sb1, sbuf* sb2, size_t pos, size_t len, sbuf_diff* d, si
 			ch2 = sbuf_char(sb2, pos + i + j);
 
 			// check for NULL bytes
+			if (ch1 == NULL || ch2 == NULL) {
+				whole = 0;
+			}
 			if (ch1 == NULL && ch2 == NULL) {
 
 				// don't mark as different if both NULL
 
 				// track NULL bytes
-				d->null->ptr[i + j]++;
+				d->null[(i + j) >> 6] |= (uint64_t)1 << ((i + j) & 63);
 			}
 			else if (ch1 == NULL && ch2 != NULL) {
 
 				// NULL bytes are compared as different
 				if (d->nbd) {
-					val2 += *ch2;
+					val2 |= (size_t)*ch2 << s;
 
 					// mark as different
 					diff = 1;
@@ -193,14 +187,14 @@ int sbuf_diff_cmp(sbuf* sb1, sbuf* sb2, size_t pos, size_t len, sbuf_diff* d, si
 				}
 				else {
 					// track NULL bytes
-					d->null->ptr[i + j]++;
+					d->null[(i + j) >> 6] |= (uint64_t)1 << ((i + j) & 63);
 				}
 			}
 			else if (ch1 != NULL && ch2 == NULL) {
 
 				// NULL bytes are compared as different
 				if (d->nbd) {
-					val1 += *ch1;
+					val1 |= (size_t)*ch1 << s;
 
 					// mark as different
 					diff = 1;
@@ -209,50 +203,381 @@ int sbuf_diff_cmp(sbuf* sb1, sbuf* sb2, size_t pos, size_t len, sbuf_diff* d, si
 				}
 				else {
 					// track NULL bytes
-					d->null->ptr[i + j]++;
+					d->null[(i + j) >> 6] |= (uint64_t)1 << ((i + j) & 63);
 				}
 			}
 			else {
 				// add byte values
-				val1 += *ch1;
-				val2 += *ch2;
+				val1 |= (size_t)*ch1 << s;
+				val2 |= (size_t)*ch2 << s;
 
 				// mark as different
-				if (val1 != val2) {
+				if ((*ch1 ^ *ch2) & (w->mask >> s) & 0xff) {
 					diff = 1;
 				}
 			}
 		}
 
+		// whole words within the tolerance are not different
+		if (diff && whole && w->tol != NULL && w->tol(w, val1 & w->mask, val2 & w->mask)) {
+			diff = 0;
+		}
+
 		// update difference structure if marked as different
 		if (diff) {
 
-			// calculate the difference
-			vald = val2 - val1;
-
-			// increment difference count
-			d->cnt += word_size;
+			// calculate the difference of the compared bits
+			vald = (val2 & w->mask) - (val1 & w->mask);
 
 			// mark differences and set values
 			// according to word size
-			for (j = 0; ((j < word_size) && ((i + j) < len)); j++) {
-				if (d->cmp[i + j] == 0) {
-					d->sub->ptr[i + j] = (vald >> (8 * (word_size - 1 - j))) & 0xff;
+			for (j = 0; ((j < w->size) && ((i + j) < len)); j++) {
+				if (! SBUF_DIFF_BIT(d->cmp, i + j)) {
+					s = w->little ? (8 * j) : (8 * (w->size - 1 - j));
+					d->sub->ptr[i + j] = (vald >> s) & 0xff;
 				}
-				d->cmp[i + j]++;
+				d->cmp[(i + j) >> 6] |= (uint64_t)1 << ((i + j) & 63);
+			}
+		}
+	}
+}
+
+/**********************************************************/
+/*
+ * Byte order conversions between memory and host values, for each byte order
+ * of words. Conversions to the host byte order are no-ops.
+ */
+#define SBUF_DIFF_SWAP8(v)	(v)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SBUF_DIFF_BE16(v)	(v)
+#define SBUF_DIFF_BE32(v)	(v)
+#define SBUF_DIFF_BE64(v)	(v)
+#define SBUF_DIFF_LE16(v)	__builtin_bswap16(v)
+#define SBUF_DIFF_LE32(v)	__builtin_bswap32(v)
+#define SBUF_DIFF_LE64(v)	__builtin_bswap64(v)
+#else
+#define SBUF_DIFF_BE16(v)	__builtin_bswap16(v)
+#define SBUF_DIFF_BE32(v)	__builtin_bswap32(v)
+#define SBUF_DIFF_BE64(v)	__builtin_bswap64(v)
+#define SBUF_DIFF_LE16(v)	(v)
+#define SBUF_DIFF_LE32(v)	(v)
+#define SBUF_DIFF_LE64(v)	(v)
+#endif
+
+/*
+ * Defines a loader and a comparator of whole words of the given type, using
+ * the given byte order conversion. Words are loaded with memcpy(), which
+ * compiles to a single unaligned load, and compared as integers. Since the
+ * word size divides 64 and words start at multiples of the word size, the
+ * bits of a word are always within one word of the bitsets. The differences
+ * of a word are either all marked or all unmarked, so only the first bit of a
+ * word is tested. Only the bits of the mask of the word comparator are
+ * compared and subtracted, and words within its tolerance, if any, are not
+ * marked.
+ */
+#define SBUF_DIFF_WORD(name, type, swap)					\
+static size_t sbuf_diff_load_##name(const unsigned char* p) {			\
+	type v;									\
+										\
+	memcpy(&v, p, sizeof(type));						\
+	return (size_t)swap(v);							\
+}										\
+										\
+static void sbuf_diff_cmp_##name(sbuf_diff* d, const unsigned char* p1, const unsigned char* p2, size_t len, sbuf_diff_word* w) { \
+	size_t i;								\
+	type v1;								\
+	type v2;								\
+	type vd;								\
+	type m;									\
+										\
+	m = swap((type)w->mask);						\
+	for (i = 0; i + sizeof(type) <= len; i += sizeof(type)) {		\
+		memcpy(&v1, p1 + i, sizeof(type));				\
+		memcpy(&v2, p2 + i, sizeof(type));				\
+		if (((v1 ^ v2) & m) == 0) {					\
+			continue;						\
+		}								\
+		v1 = swap(v1) & (type)w->mask;					\
+		v2 = swap(v2) & (type)w->mask;					\
+		if (w->tol != NULL && w->tol(w, (size_t)v1, (size_t)v2)) {	\
+			continue;						\
+		}								\
+		if (! SBUF_DIFF_BIT(d->cmp, i)) {				\
+			vd = (type)(v2 - v1);					\
+			vd = swap(vd);						\
+			memcpy(d->sub->ptr + i, &vd, sizeof(type));		\
+		}								\
+		d->cmp[i >> 6] |= (~(uint64_t)0 >> (64 - sizeof(type))) << (i & 63);	\
+	}									\
+}
+
+SBUF_DIFF_WORD(8, uint8_t, SBUF_DIFF_SWAP8)
+SBUF_DIFF_WORD(be16, uint16_t, SBUF_DIFF_BE16)
+SBUF_DIFF_WORD(be32, uint32_t, SBUF_DIFF_BE32)
+SBUF_DIFF_WORD(be64, uint64_t, SBUF_DIFF_BE64)
+SBUF_DIFF_WORD(le16, uint16_t, SBUF_DIFF_LE16)
+SBUF_DIFF_WORD(le32, uint32_t, SBUF_DIFF_LE32)
+SBUF_DIFF_WORD(le64, uint64_t, SBUF_DIFF_LE64)
+
+/**********************************************************/
+/*
+ * Returns 1 if the given absolute difference of two values is within the
+ * tolerance of the given word comparator, or 0 otherwise. A relative tolerance
+ * is scaled by the larger magnitude of the values. Differences that are not a
+ * number are never within the tolerance.
+ */
+static int sbuf_diff_within(sbuf_diff_word* w, double diff, double a, double b) {
+
+	if (! w->rel) {
+		return diff <= w->eps;
+	}
+
+	a = (a < 0) ? -a : a;
+	b = (b < 0) ? -b : b;
+	return diff <= w->eps * (a > b ? a : b);
+}
+
+/**********************************************************/
+/*
+ * Returns 1 if the given values of words, assembled in the byte order of the
+ * given word comparator, are within its tolerance as unsigned integers, or 0
+ * otherwise. The difference is exact before it is compared.
+ */
+static int sbuf_diff_tol_unsigned(sbuf_diff_word* w, size_t v1, size_t v2) {
+
+	return sbuf_diff_within(w, (double)(v1 > v2 ? v1 - v2 : v2 - v1), (double)v1, (double)v2);
+}
+
+/**********************************************************/
+/*
+ * Returns 1 if the given values of words are within the tolerance of the given
+ * word comparator as signed integers of the word size, or 0 otherwise.
+ */
+static int sbuf_diff_tol_signed(sbuf_diff_word* w, size_t v1, size_t v2) {
+	int64_t s1;
+	int64_t s2;
+	int shift;
+
+	// sign extend from the word size
+	shift = 64 - (int)(8 * w->size);
+	s1 = (int64_t)((uint64_t)v1 << shift) >> shift;
+	s2 = (int64_t)((uint64_t)v2 << shift) >> shift;
+
+	return sbuf_diff_within(w, (double)(s1 > s2 ? (uint64_t)s1 - (uint64_t)s2 : (uint64_t)s2 - (uint64_t)s1), (double)s1, (double)s2);
+}
+
+/**********************************************************/
+/*
+ * Returns 1 if the given values of 4-byte words are within the tolerance of
+ * the given word comparator as IEEE floats, or 0 otherwise.
+ */
+static int sbuf_diff_tol_float(sbuf_diff_word* w, size_t v1, size_t v2) {
+	uint32_t u1;
+	uint32_t u2;
+	float f1;
+	float f2;
+
+	u1 = (uint32_t)v1;
+	u2 = (uint32_t)v2;
+	memcpy(&f1, &u1, sizeof(float));
+	memcpy(&f2, &u2, sizeof(float));
+
+	return sbuf_diff_within(w, (f1 > f2) ? (double)f1 - f2 : (double)f2 - f1, f1, f2);
+}
+
+/**********************************************************/
+/*
+ * Returns 1 if the given values of 8-byte words are within the tolerance of
+ * the given word comparator as IEEE doubles, or 0 otherwise.
+ */
+static int sbuf_diff_tol_double(sbuf_diff_word* w, size_t v1, size_t v2) {
+	uint64_t u1;
+	uint64_t u2;
+	double f1;
+	double f2;
+
+	u1 = (uint64_t)v1;
+	u2 = (uint64_t)v2;
+	memcpy(&f1, &u1, sizeof(double));
+	memcpy(&f2, &u2, sizeof(double));
+
+	return sbuf_diff_within(w, (f1 > f2) ? f1 - f2 : f2 - f1, f1, f2);
+}
+
+/**********************************************************/
+/*
+ * Initializes the given word comparator for words of the given size and byte
+ * order, selecting the specialized loader and comparator for word sizes of 1,
+ * 2, 4 and 8 bytes. Other word sizes are compared one byte at a time. Returns
+ * 0 if successful, or -1 if error.
+ */
+int sbuf_diff_word_init(sbuf_diff_word* w, size_t size, int little) {
+
+	// check parameters
+	if (w == NULL || size == 0 || size > sizeof(size_t)) {
+		return -1;
+	}
+
+	// set default values
+	w->size = size;
+	w->little = little ? 1 : 0;
+	w->mask = (size < sizeof(size_t)) ? ((size_t)1 << (8 * size)) - 1 : ~(size_t)0;
+	w->eps = 0;
+	w->rel = 0;
+	w->load = NULL;
+	w->cmp = NULL;
+	w->tol = NULL;
+
+	// select specialization
+	switch (size) {
+		case 1:
+			w->load = sbuf_diff_load_8;
+			w->cmp = sbuf_diff_cmp_8;
+			break;
+		case 2:
+			w->load = little ? sbuf_diff_load_le16 : sbuf_diff_load_be16;
+			w->cmp = little ? sbuf_diff_cmp_le16 : sbuf_diff_cmp_be16;
+			break;
+		case 4:
+			w->load = little ? sbuf_diff_load_le32 : sbuf_diff_load_be32;
+			w->cmp = little ? sbuf_diff_cmp_le32 : sbuf_diff_cmp_be32;
+			break;
+		case 8:
+			w->load = little ? sbuf_diff_load_le64 : sbuf_diff_load_be64;
+			w->cmp = little ? sbuf_diff_cmp_le64 : sbuf_diff_cmp_be64;
+			break;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Sets the tolerance of the given word comparator, so that words whose values
+ * of the given type differ by at most eps are compared as equal. The tolerance
+ * is absolute, or relative to the larger magnitude of the two values if rel is
+ * set. Floats require words of 4 or 8 bytes. Returns 0 if successful, or -1 if
+ * error.
+ */
+int sbuf_diff_word_tolerance(sbuf_diff_word* w, int type, double eps, int rel) {
+
+	// check parameters
+	if (w == NULL || ! (eps >= 0)) {
+		return -1;
+	}
+
+	// select type
+	switch (type) {
+		case SBUF_DIFF_UNSIGNED:
+			w->tol = sbuf_diff_tol_unsigned;
+			break;
+		case SBUF_DIFF_SIGNED:
+			w->tol = sbuf_diff_tol_signed;
+			break;
+		case SBUF_DIFF_FLOAT:
+			if (w->size == sizeof(float)) {
+				w->tol = sbuf_diff_tol_float;
+			}
+			else if (w->size == sizeof(double)) {
+				w->tol = sbuf_diff_tol_double;
+			}
+			else {
+				return -1;
 			}
+			break;
+		default:
+			return -1;
+	}
+
+	w->eps = eps;
+	w->rel = rel ? 1 : 0;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Returns the value of the word at the given position of the given buffer in
+ * the byte order of the given word comparator, using only the first n bytes
+ * of the word. Bytes past n and NULL bytes are zero, so a partial big-endian
+ * word is padded as with sbuf_word().
+ */
+size_t sbuf_diff_word_value(sbuf_diff_word* w, sbuf* sb, size_t pos, size_t n) {
+	unsigned char* ch;
+	size_t value;
+	size_t j;
+
+	// whole word within buffer
+	if (w->load != NULL && n >= w->size && pos >= sb->pos && pos + w->size <= sb->pos + sb->len) {
+		return w->load(sb->ptr + (pos - sb->pos));
+	}
+
+	// one byte at a time
+	value = 0;
+	for (j = 0; j < w->size && j < n; j++) {
+		ch = sbuf_char(sb, pos + j);
+		if (ch != NULL) {
+			value |= (size_t)*ch << (w->little ? (8 * j) : (8 * (w->size - 1 - j)));
 		}
 	}
 
+	return value;
+}
+
+/**********************************************************/
+/*
+ * Compares two buffers at the given position and length and updates the given
+ * difference structure to indicate which bytes were different, according to
+ * the word size and byte order of the given word comparator. Lines entirely
+ * within both buffers are compared with the specialized comparator, if any,
+ * and only a partial last word is compared one byte at a time. The
+ * differences of every pair of buffers compared with the same structure are
+ * combined in a single bitset. Returns the number of differing bytes in the
+ * structure.
+ */
+int sbuf_diff_cmp(sbuf* sb1, sbuf* sb2, size_t pos, size_t len, sbuf_diff* d, sbuf_diff_word* w) {
+	size_t i;
+
+	// check parameters
+	if (sb1 == NULL || sb2 == NULL) {
+		return -1;
+	}
+	if (d == NULL || w == NULL) {
+		return -1;
+	}
+
+	// save position
+	d->pos = pos;
+
+	// copy position/length to subtraction buffer
+	d->sub->pos = pos;
+	d->sub->len = len;
+
+	// whole words of a line without NULL bytes
+	i = 0;
+	if (w->cmp != NULL
+		&& pos >= sb1->pos && pos + len <= sb1->pos + sb1->len
+		&& pos >= sb2->pos && pos + len <= sb2->pos + sb2->len) {
+		w->cmp(d, sb1->ptr + (pos - sb1->pos), sb2->ptr + (pos - sb2->pos), len, w);
+		i = len - (len % w->size);
+	}
+
+	// remaining words
+	sbuf_diff_cmp_bytes(sb1, sb2, pos, i, len, d, w);
+
+	// count differences
+	d->cnt = sbuf_diff_bytes(d);
+
 	return d->cnt;
 }
 
 /**********************************************************/
 /*
  * Modifies the given difference structure to unmark groups of bytes provided
- * in the given ignore structure, consistent with the word size.
+ * in the given ignore structure, consistent with the word size and byte order
+ * of the given word comparator.
  */
-int sbuf_diff_unmark_ignore(sbuf_diff* d, size_t word_size, llq_list* ignore) {
+int sbuf_diff_unmark_ignore(sbuf_diff* d, sbuf_diff_word* w, llq_list* ignore) {
 	size_t i;
 	size_t j;
 	size_t s;
@@ -272,25 +597,24 @@ int sbuf_diff_unmark_ignore(sbuf_diff* d, size_t word_size, llq_list* ignore) {
 		v = llq_num_value(node);
 
 		// loop through difference values
-		for (i = 0; i < d->width; i += word_size) {
+		for (i = 0; i < d->width; i += w->size) {
 
 			// get word size value
-			s = sbuf_word(d->sub, d->pos + i, word_size);
+			s = sbuf_diff_word_value(w, d->sub, d->pos + i, w->size);
 
 			// word size value matches the ignore
 			if (s == v) {
 
 				// loop through all bytes in word size
-				for (j = i; j < (i + word_size); j++) {
+				for (j = i; j < (i + w->size) && j < d->width; j++) {
 
 					// reset highlight
-					if (d->cmp[j] > 0) {
-						d->cnt -= d->cmp[j];
-						d->cmp[j] = 0;
+					if (SBUF_DIFF_BIT(d->cmp, j)) {
+						d->cmp[j >> 6] &= ~((uint64_t)1 << (j & 63));
 
 						// invalidate diff
 						d->sub->ptr[j] = 0;
-						d->null->ptr[j] = 0;
+						d->null[j >> 6] &= ~((uint64_t)1 << (j & 63));
 					}
 				}
 			}
@@ -300,7 +624,505 @@ int sbuf_diff_unmark_ignore(sbuf_diff* d, size_t word_size, llq_list* ignore) {
 		node = node->next;
 	}
 
+	// count remaining differences
+	d->cnt = sbuf_diff_bytes(d);
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Returns the number of bytes marked as different in the given difference
+ * structure, regardless of how many files differ at each byte.
+ */
+size_t sbuf_diff_bytes(sbuf_diff* d) {
+	size_t i;
+	size_t bytes;
+
+	// check parameters
+	if (d == NULL) {
+		return 0;
+	}
+
+	// count bits in bitset
+	bytes = 0;
+	for (i = 0; i < d->words; i++) {
+		bytes += __builtin_popcountll(d->cmp[i]);
+	}
+
+	return bytes;
+}
+
+/**********************************************************/
+/*
+ * Returns 1 if at least one byte is marked as different in the given
+ * difference structure, otherwise returns 0.
+ */
+int sbuf_diff_any(sbuf_diff* d) {
+	size_t i;
+	uint64_t any;
+
+	// check parameters
+	if (d == NULL) {
+		return 0;
+	}
+
+	// combine all words of bitset
+	any = 0;
+	for (i = 0; i < d->words; i++) {
+		any |= d->cmp[i];
+	}
+
+	return (any != 0);
+}
+
+/**********************************************************/
+/*
+ * Returns the index of the next byte marked as different at or after the
+ * given index, or the width of the difference structure if there are none.
+ * Returns (size_t)-1 if the difference structure is NULL.
+ */
+size_t sbuf_diff_next(sbuf_diff* d, size_t i) {
+	size_t w;
+	uint64_t bits;
+
+	// check parameters
+	if (d == NULL) {
+		return (size_t)-1;
+	}
+	if (i >= d->width) {
+		return d->width;
+	}
+
+	// mask bits before index in first word
+	w = i >> 6;
+	bits = d->cmp[w] & (~(uint64_t)0 << (i & 63));
+
+	// find next word with a bit set
+	while (bits == 0) {
+		w++;
+		if (w >= d->words) {
+			return d->width;
+		}
+		bits = d->cmp[w];
+	}
+
+	return (w << 6) + __builtin_ctzll(bits);
+}
+
+/**********************************************************/
+/*
+ * Allocates and initializes a new batch structure to hold the differences of
+ * up to max_cnt lines of the given width. Returns the new structure, or NULL
+ * if error.
+ */
+sbuf_diff_batch* sbuf_diff_batch_malloc(size_t width, size_t max_cnt) {
+	sbuf_diff_batch* b;
+	size_t i;
+
+	// check parameters
+	if (width == 0 || max_cnt == 0) {
+		return NULL;
+	}
+
+	// allocate memory for the structure
+	b = (sbuf_diff_batch*)malloc(sizeof(sbuf_diff_batch));
+	if (b == NULL) {
+		return NULL;
+	}
+
+	// all bits are compared
+	b->mask = NULL;
+
+	// allocate memory for line indices
+	b->idx = (size_t*)malloc(sizeof(size_t) * max_cnt);
+	if (b->idx == NULL) {
+		free(b);
+		return NULL;
+	}
+
+	// allocate memory for difference pointers
+	b->diff = (sbuf_diff**)malloc(sizeof(sbuf_diff*) * max_cnt);
+	if (b->diff == NULL) {
+		free(b->idx);
+		free(b);
+		return NULL;
+	}
+
+	// allocate difference structures
+	for (i = 0; i < max_cnt; i++) {
+		b->diff[i] = sbuf_diff_malloc(width);
+		if (b->diff[i] == NULL) {
+			b->max_cnt = i;
+			sbuf_diff_batch_free(b);
+			return NULL;
+		}
+	}
+
+	// set default values
+	b->max_cnt = max_cnt;
+	b->width = width;
+	b->pos = 0;
+	b->lines = 0;
+	b->cnt = 0;
+	b->nbd = 0;
+
+	return b;
+}
+
+/**********************************************************/
+/*
+ * Frees the memory used by the given batch structure, including all of the
+ * difference structures.
+ */
+void sbuf_diff_batch_free(sbuf_diff_batch* b) {
+	size_t i;
+
+	if (b != NULL) {
+
+		// free difference structures
+		if (b->diff != NULL) {
+			for (i = 0; i < b->max_cnt; i++) {
+				sbuf_diff_free(b->diff[i]);
+			}
+			free(b->diff);
+		}
+
+		// free line indices
+		if (b->idx != NULL) {
+			free(b->idx);
+		}
+
+		// free mask
+		mem_free(b->mask);
+
+		// free batch structure
+		free(b);
+	}
+}
+
+/**********************************************************/
+/*
+ * Sets the mask of each byte of a line of the given batch from the mask of
+ * the given word comparator, so that lines can be compared in bulk without
+ * assembling words. Words start at multiples of the word size within a line,
+ * and a partial last word is masked as the start of a whole word. The mask is
+ * padded with zeros to a multiple of 8 bytes. The mask is removed if all bits
+ * are compared. Returns 0 if successful, or -1 if error.
+ */
+int sbuf_diff_batch_mask(sbuf_diff_batch* b, sbuf_diff_word* w) {
+	sbuf_diff_word all;
+	size_t len;
+	size_t k;
+	size_t j;
+
+	// check parameters
+	if (b == NULL || w == NULL) {
+		return -1;
+	}
+
+	// all bits are compared
+	sbuf_diff_word_init(&all, w->size, w->little);
+	if (w->mask == all.mask) {
+		mem_free(b->mask);
+		b->mask = NULL;
+		return 0;
+	}
+
+	// allocate mask, rounded up to whole 64-bit blocks
+	len = b->width + ((8 - (b->width % 8)) % 8);
+	if (b->mask == NULL) {
+		b->mask = (unsigned char*)mem_alloc(len, MEM_ALIGN);
+		if (b->mask == NULL) {
+			return -1;
+		}
+	}
+	memset(b->mask, 0, len);
+
+	// bits of each byte at its position within its word
+	for (k = 0; k < b->width; k++) {
+		j = k % w->size;
+		b->mask[k] = (w->mask >> (w->little ? (8 * j) : (8 * (w->size - 1 - j)))) & 0xff;
+	}
+
 	return 0;
 }
 
 /**********************************************************/
+/*
+ * Returns the index of the first byte that differs between the two given
+ * pointers, or n if all n bytes are the same. Large blocks are compared with
+ * memcmp() and only a block containing a difference is compared byte by byte.
+ */
+static size_t sbuf_diff_mismatch(unsigned char* p1, unsigned char* p2, size_t n) {
+	size_t i;
+	size_t blk;
+
+	for (i = 0; i < n; i += blk) {
+
+		// compare next block
+		blk = (n - i < 256) ? (n - i) : 256;
+		if (memcmp(p1 + i, p2 + i, blk) != 0) {
+
+			// find byte within block
+			while (p1[i] == p2[i]) {
+				i++;
+			}
+			return i;
+		}
+	}
+
+	return n;
+}
+
+/**********************************************************/
+/*
+ * Returns the index of the first byte that differs in the bits of the given
+ * mask of a line between the two given pointers, which are at the start of a
+ * line, or n if all n bytes are the same. Identical data is skipped with
+ * sbuf_diff_mismatch(), and only a line containing a difference is compared
+ * under the mask, 64 bits at a time, accumulating the masked differences of
+ * the whole line before testing them.
+ */
+static size_t sbuf_diff_mismatch_mask(unsigned char* p1, unsigned char* p2, unsigned char* mask, size_t width, size_t n) {
+	size_t i;
+	size_t k;
+	size_t len;
+	uint64_t v1;
+	uint64_t v2;
+	uint64_t m;
+	uint64_t acc;
+
+	i = 0;
+	while (i < n) {
+
+		// start of the line of the next unmasked difference
+		i += sbuf_diff_mismatch(p1 + i, p2 + i, n - i);
+		if (i >= n) {
+			break;
+		}
+		i -= i % width;
+
+		// compare line, the mask is padded to whole blocks
+		len = (n - i < width) ? (n - i) : width;
+		acc = 0;
+		for (k = 0; k + 8 <= len; k += 8) {
+			memcpy(&v1, p1 + i + k, 8);
+			memcpy(&v2, p2 + i + k, 8);
+			memcpy(&m, mask + k, 8);
+			acc |= (v1 ^ v2) & m;
+		}
+		for (; k < len; k++) {
+			acc |= (p1[i + k] ^ p2[i + k]) & mask[k];
+		}
+
+		// find byte within line
+		if (acc != 0) {
+			k = 0;
+			while (((p1[i + k] ^ p2[i + k]) & mask[k]) == 0) {
+				k++;
+			}
+			return i + k;
+		}
+
+		// next line
+		i += len;
+	}
+
+	return n;
+}
+
+/**********************************************************/
+/*
+ * Returns the index of the first line at or after the given line which may
+ * contain a difference, or lines if none of the remaining lines can differ.
+ * Data ranges where every buffer is either completely filled or completely
+ * empty are compared in bulk. Lines where a buffer starts or ends, or where
+ * NULL bytes would be compared as different, are always returned so that they
+ * can be compared with sbuf_diff_cmp(). If the batch has a mask, only the
+ * masked bits are compared.
+ */
+static size_t sbuf_diff_batch_next(sbuf_diff_batch* b, sbuf** sb, int sb_cnt, size_t pos, size_t len, size_t line, size_t lines) {
+	int i;
+	int full;
+	int empty;
+	int first;
+	size_t p;
+	size_t q;
+	size_t e;
+	size_t m;
+	size_t last;
+
+	e = pos + len;
+	while (line < lines) {
+
+		// start of current line
+		p = pos + line * b->width;
+
+		// end of range where no buffer starts or ends
+		q = e;
+		for (i = 0; i < sb_cnt; i++) {
+			if (sb[i]->pos > p && sb[i]->pos < q) {
+				q = sb[i]->pos;
+			}
+			if (sb[i]->pos + sb[i]->len > p && sb[i]->pos + sb[i]->len < q) {
+				q = sb[i]->pos + sb[i]->len;
+			}
+		}
+
+		// last line (exclusive) that is entirely within range
+		if (q >= e) {
+			last = lines;
+			q = e;
+		}
+		else {
+			last = (q - pos) / b->width;
+			q = pos + last * b->width;
+		}
+
+		// a buffer starts or ends within this line
+		if (last <= line) {
+			return line;
+		}
+
+		// count buffers with and without data in range
+		full = 0;
+		empty = 0;
+		first = -1;
+		for (i = 0; i < sb_cnt; i++) {
+			if (sb[i]->pos <= p && p < sb[i]->pos + sb[i]->len) {
+				if (first < 0) {
+					first = i;
+				}
+				full++;
+			}
+			else {
+				empty++;
+			}
+		}
+
+		// NULL bytes compared with data are always different
+		if (b->nbd && full > 0 && empty > 0) {
+			return line;
+		}
+
+		// compare all buffers with data against the first
+		m = q;
+		if (full > 1) {
+			for (i = first + 1; i < sb_cnt; i++) {
+				if (sb[i]->pos > p || p >= sb[i]->pos + sb[i]->len) {
+					continue;
+				}
+				if (b->mask != NULL) {
+					m = p + sbuf_diff_mismatch_mask(
+						sb[first]->ptr + (p - sb[first]->pos),
+						sb[i]->ptr + (p - sb[i]->pos),
+						b->mask,
+						b->width,
+						m - p
+					);
+				}
+				else {
+					m = p + sbuf_diff_mismatch(
+						sb[first]->ptr + (p - sb[first]->pos),
+						sb[i]->ptr + (p - sb[i]->pos),
+						m - p
+					);
+				}
+			}
+		}
+
+		// line containing the first difference
+		if (m < q) {
+			return (m - pos) / b->width;
+		}
+
+		// no differences, continue after range
+		line = last;
+	}
+
+	return lines;
+}
+
+/**********************************************************/
+/*
+ * Compares all of the given buffers over len bytes starting at the given
+ * position, one line of the batch width at a time. Each pair of buffers is
+ * compared as with sbuf_diff_cmp(), and ignored differences are unmarked as
+ * with sbuf_diff_unmark_ignore(). The index and difference structure of each
+ * line with at least one difference is stored in the batch. Comparison stops
+ * early if the batch is full. Returns the number of lines compared, which is
+ * also stored in the batch.
+ */
+size_t sbuf_diff_batch_cmp(sbuf_diff_batch* b, sbuf** sb, int sb_cnt, size_t pos, size_t len, sbuf_diff_word* w, llq_list* ignore) {
+	int i;
+	int j;
+	size_t line;
+	size_t lines;
+	size_t lpos;
+	size_t llen;
+	sbuf_diff* d;
+
+	// check parameters
+	if (b == NULL || sb == NULL) {
+		return 0;
+	}
+
+	// set default values
+	b->pos = pos;
+	b->lines = 0;
+	b->cnt = 0;
+
+	// number of lines, including a partial last line
+	lines = (len / b->width) + (len % b->width > 0 ? 1 : 0);
+
+	// loop through lines which may differ
+	line = sbuf_diff_batch_next(b, sb, sb_cnt, pos, len, 0, lines);
+	while (line < lines) {
+
+		// batch is full, stop before this line
+		if (b->cnt >= b->max_cnt) {
+			b->lines = line;
+			return b->lines;
+		}
+
+		// position and length of line
+		lpos = pos + line * b->width;
+		llen = len - line * b->width;
+		if (llen > b->width) {
+			llen = b->width;
+		}
+
+		// reset next difference structure
+		d = b->diff[b->cnt];
+		sbuf_diff_init(d);
+		d->nbd = b->nbd;
+
+		// loop doubly through buffers for comparison
+		for (i = 1; i < sb_cnt; i++) {
+		for (j = 0; j < i; j++) {
+
+			// compare lines
+			if (sbuf_diff_cmp(sb[j], sb[i], lpos, llen, d, w) > 0) {
+
+				// unmark ignore values
+				sbuf_diff_unmark_ignore(d, w, ignore);
+			}
+		}
+		}
+
+		// keep line with at least one difference
+		if (sbuf_diff_any(d)) {
+			b->idx[b->cnt] = line;
+			b->cnt++;
+		}
+
+		// find next line
+		line = sbuf_diff_batch_next(b, sb, sb_cnt, pos, len, line + 1, lines);
+	}
+
+	b->lines = lines;
+	return b->lines;
+}
+
+/**********************************************************/
@@ -1,25 +1,72 @@
 #ifndef _SBUF_DIFF_H
 #define _SBUF_DIFF_H
 
+#include <stdint.h>
 #include "sbuf.h"
 #include "llq.h"
 
+// test a single bit in a difference bitset
+#define SBUF_DIFF_BIT(set, i)	(((set)[(i) >> 6] >> ((i) & 63)) & 1)
+
 struct sbuf_diff {
-	unsigned char* cmp;	// boolean flags
+	uint64_t* cmp;		// bitset of differing bytes
 	sbuf* sub;		// buffer for substraction differences
-	sbuf* null;		// buffer for NULL differences
+	uint64_t* null;		// bitset of NULL bytes
 	size_t width;		// number of bytes per line per file
+	size_t words;		// number of words in each bitset
 	size_t pos;		// relative position
-	size_t cnt;		// number of differences found
+	size_t cnt;		// number of differing bytes found
 	int nbd;		// NULL bytes are compared as different
 };
 typedef struct sbuf_diff sbuf_diff;
 
+// types of the values of words compared within a tolerance
+#define SBUF_DIFF_UNSIGNED	'u'		// unsigned integers
+#define SBUF_DIFF_SIGNED	'i'		// signed integers
+#define SBUF_DIFF_FLOAT		'f'		// IEEE floats of 4 bytes or doubles of 8 bytes
+
+// word size and byte order, with a specialized comparator if available
+struct sbuf_diff_word {
+	size_t size;		// number of bytes per word
+	int little;		// flag for little-endian words
+	size_t mask;		// bits of each word that are compared, all by default
+	double eps;		// tolerance of values compared as equal
+	int rel;		// flag for a tolerance relative to the larger value
+	size_t (*load)(const unsigned char* p);	// loads a whole word, NULL if none
+	void (*cmp)(sbuf_diff* d, const unsigned char* p1, const unsigned char* p2, size_t len, struct sbuf_diff_word* w);	// compares whole words, NULL if none
+	int (*tol)(struct sbuf_diff_word* w, size_t v1, size_t v2);	// tests whether values are within the tolerance, NULL if exact
+};
+typedef struct sbuf_diff_word sbuf_diff_word;
+
+struct sbuf_diff_batch {
+	sbuf_diff** diff;	// difference structures for differing lines
+	size_t* idx;		// line index of each differing line
+	size_t max_cnt;		// maximum number of differing lines
+	size_t width;		// number of bytes per line per file
+	size_t pos;		// position of the first line
+	size_t lines;		// number of lines compared
+	size_t cnt;		// number of differing lines found
+	int nbd;		// NULL bytes are compared as different
+	unsigned char* mask;	// compared bits of each byte of a line, NULL if all
+};
+typedef struct sbuf_diff_batch sbuf_diff_batch;
+
 int sbuf_diff_init(sbuf_diff* d);
 sbuf_diff* sbuf_diff_malloc(size_t width);
 void sbuf_diff_free(sbuf_diff* d);
-int sbuf_diff_cmp(sbuf* sb1, sbuf* sb2, size_t pos, size_t len, sbuf_diff* d, size_t word_size);
+int sbuf_diff_word_init(sbuf_diff_word* w, size_t size, int little);
+int sbuf_diff_word_tolerance(sbuf_diff_word* w, int type, double eps, int rel);
+size_t sbuf_diff_word_value(sbuf_diff_word* w, sbuf* sb, size_t pos, size_t n);
+int sbuf_diff_cmp(sbuf* sb1, sbuf* sb2, size_t pos, size_t len, sbuf_diff* d, sbuf_diff_word* w);
 int sbuf_diff_mark_groups(sbuf_diff* d, size_t word_size);
-int sbuf_diff_unmark_ignore(sbuf_diff* d, size_t word_size, llq_list* ignore);
+int sbuf_diff_unmark_ignore(sbuf_diff* d, sbuf_diff_word* w, llq_list* ignore);
+size_t sbuf_diff_bytes(sbuf_diff* d);
+int sbuf_diff_any(sbuf_diff* d);
+size_t sbuf_diff_next(sbuf_diff* d, size_t i);
+
+sbuf_diff_batch* sbuf_diff_batch_malloc(size_t width, size_t max_cnt);
+void sbuf_diff_batch_free(sbuf_diff_batch* b);
+int sbuf_diff_batch_mask(sbuf_diff_batch* b, sbuf_diff_word* w);
+size_t sbuf_diff_batch_cmp(sbuf_diff_batch* b, sbuf** sb, int sb_cnt, size_t pos, size_t len, sbuf_diff_word* w, llq_list* ignore);
 
 #endif /* _SBUF_DIFF_H */
@@ -0,0 +1,303 @@
+/*
+ * sbuf_map - regions of a file
+ *
+ * Provides regions of a file for the file structure, given as
+ * FILE@OFFSET+LENGTH, or FILE@OFFSET for the rest of the file. All regions of
+ * the same file, found by device and inode number, share a single read-only
+ * mapping of the file, so comparing regions of one image opens it once and
+ * reads each byte from the device only once, even where regions overlap.
+ * Each region copies the data of the mapping into its own structured buffer,
+ * as if it were a file of the length of the region.
+ */
+
+#include <stdio.h>		// NULL
+#include <stdlib.h>		// malloc(), free()
+#include <string.h>		// strrchr(), memcpy()
+#include <stdint.h>		// uint64_t, SIZE_MAX
+#include <unistd.h>		// close()
+#include <fcntl.h>		// open()
+#include <sys/mman.h>		// mmap(), munmap()
+#include <sys/stat.h>		// stat(), fstat()
+#include <sys/ioctl.h>		// ioctl()
+#ifdef __linux__
+#include <linux/fs.h>		// BLKGETSIZE64
+#endif
+#include "sbuf.h"
+#include "sbuf_map.h"
+#include "value.h"
+
+struct sfile_map {
+	struct sfile_map* next;	// mapping of another file
+	dev_t dev;		// device of the file
+	ino_t ino;		// inode of the file
+	int fd;			// file descriptor
+	unsigned char* ptr;	// mapped file, or NULL if empty
+	size_t size;		// size of the file
+	int refs;		// number of regions using the mapping
+};
+typedef struct sfile_map sfile_map;
+
+// mappings of all files with open regions
+static sfile_map* sfile_maps = NULL;
+
+/**********************************************************/
+/*
+ * Parses the given region into the path of the file, which must be freed,
+ * the offset and the length, which is SIZE_MAX if not given. Returns 0 if
+ * successful, or -1 if the path is not a region.
+ */
+static int sfile_map_parse(char* path, char** file, size_t* off, size_t* len) {
+	char* at;
+	char* end;
+
+	// last separator, file names may include it as well
+	at = strrchr(path, SFILE_MAP_AT);
+	if (at == NULL || at == path) {
+		return -1;
+	}
+
+	// offset and optional length
+	if (value_parse(at + 1, &end, off) < 0) {
+		return -1;
+	}
+	*len = SIZE_MAX;
+	if (*end == SFILE_MAP_LEN && value_parse(end + 1, &end, len) < 0) {
+		return -1;
+	}
+	if (*end != '\0') {
+		return -1;
+	}
+
+	// path of the file
+	*file = (char*)malloc((at - path) + 1);
+	if (*file == NULL) {
+		return -1;
+	}
+	memcpy(*file, path, at - path);
+	(*file)[at - path] = '\0';
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Returns 1 if the given path is a region of a file, or 0 otherwise. An
+ * existing file is never a region, even if its name looks like one.
+ */
+int sfile_map_detect(char* path) {
+	struct stat buf;
+	char* file;
+	size_t off;
+	size_t len;
+
+	// existing file
+	if (stat(path, &buf) == 0) {
+		return 0;
+	}
+
+	if (sfile_map_parse(path, &file, &off, &len) < 0) {
+		return 0;
+	}
+	free(file);
+
+	return 1;
+}
+
+/**********************************************************/
+/*
+ * Maps the file with the given path, or finds the mapping of the same file
+ * already used by other regions. Only regular files and block devices can be
+ * mapped. Returns the mapping, or NULL if error.
+ */
+static sfile_map* sfile_map_file(char* file) {
+	struct stat buf;
+	sfile_map* m;
+	uint64_t size;
+	int fd;
+
+	if (stat(file, &buf) < 0) {
+		return NULL;
+	}
+
+	// file already mapped
+	for (m = sfile_maps; m != NULL; m = m->next) {
+		if (m->dev == buf.st_dev && m->ino == buf.st_ino) {
+			return m;
+		}
+	}
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	// size of regular file or block device
+	if (S_ISREG(buf.st_mode)) {
+		size = buf.st_size;
+	}
+#ifdef BLKGETSIZE64
+	else if (S_ISBLK(buf.st_mode) && ioctl(fd, BLKGETSIZE64, &size) == 0) {
+	}
+#endif
+	else {
+		close(fd);
+		return NULL;
+	}
+
+	// allocate memory for structure
+	m = (sfile_map*)malloc(sizeof(sfile_map));
+	if (m == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	// map whole file, nothing to map if empty
+	m->ptr = NULL;
+	if (size > 0) {
+		m->ptr = (unsigned char*)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (m->ptr == (unsigned char*)MAP_FAILED) {
+			free(m);
+			close(fd);
+			return NULL;
+		}
+	}
+
+	// set default values
+	m->dev = buf.st_dev;
+	m->ino = buf.st_ino;
+	m->fd = fd;
+	m->size = size;
+	m->refs = 0;
+	m->next = sfile_maps;
+	sfile_maps = m;
+
+	return m;
+}
+
+/**********************************************************/
+/*
+ * Opens the region of a file given by the path for the given file structure,
+ * mapping the file unless another region of it is open. The region is
+ * limited to the size of the file, and its length is the size of the file
+ * structure, so that EOF is reached at its end. Returns 0 if successful, or -1
+ * if error.
+ */
+int sfile_map_open(sfile* sf, char* path) {
+	sfile_map* m;
+	char* file;
+	size_t off;
+	size_t len;
+
+	// check parameters
+	if (sf == NULL || path == NULL) {
+		return -1;
+	}
+
+	if (sfile_map_parse(path, &file, &off, &len) < 0) {
+		return -1;
+	}
+	m = sfile_map_file(file);
+	free(file);
+	if (m == NULL) {
+		return -1;
+	}
+	m->refs++;
+
+	// region within the file
+	if (off > m->size) {
+		off = m->size;
+	}
+	if (len > m->size - off) {
+		len = m->size - off;
+	}
+	sf->map = m;
+	sf->region = off;
+	sf->size = (off_t)len;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Closes the region of the given file structure, unmapping the file once no
+ * other region uses it. Returns 0 if successful, or -1 if error.
+ */
+int sfile_map_close(sfile* sf) {
+	sfile_map** p;
+	sfile_map* m;
+	int ret;
+
+	// check parameters
+	if (sf == NULL || sf->map == NULL) {
+		return -1;
+	}
+
+	m = sf->map;
+	sf->map = NULL;
+
+	// other regions still use the mapping
+	m->refs--;
+	if (m->refs > 0) {
+		return 0;
+	}
+
+	// remove from mappings
+	for (p = &sfile_maps; *p != NULL; p = &(*p)->next) {
+		if (*p == m) {
+			*p = m->next;
+			break;
+		}
+	}
+
+	ret = 0;
+	if (m->ptr != NULL && munmap(m->ptr, m->size) != 0) {
+		ret = -1;
+	}
+	if (close(m->fd) != 0) {
+		ret = -1;
+	}
+	free(m);
+
+	return ret;
+}
+
+/**********************************************************/
+/*
+ * Gets the status of the mapped file of the region of the given file
+ * structure. Returns 0 if successful, or -1 if error.
+ */
+int sfile_map_stat(sfile* sf, struct stat* buf) {
+
+	// check parameters
+	if (sf == NULL || sf->map == NULL || buf == NULL) {
+		return -1;
+	}
+
+	return fstat(sf->map->fd, buf);
+}
+
+/**********************************************************/
+/*
+ * Copies up to len bytes of the region of the given file structure, at the
+ * current offset within the region, to the given memory. Returns the number
+ * of bytes copied, which is 0 at the end of the region.
+ */
+size_t sfile_map_read(sfile* sf, unsigned char* dst, size_t len) {
+	size_t n;
+
+	// check parameters
+	if (sf == NULL || sf->map == NULL || sf->offset >= (size_t)sf->size) {
+		return 0;
+	}
+
+	// limited by the end of the region
+	n = (size_t)sf->size - sf->offset;
+	if (n > len) {
+		n = len;
+	}
+	memcpy(dst, sf->map->ptr + sf->region + sf->offset, n);
+
+	return n;
+}
+
+/**********************************************************/
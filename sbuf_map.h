@@ -0,0 +1,16 @@
+#ifndef _SBUF_MAP_H
+#define _SBUF_MAP_H
+
+#include "sbuf.h"
+
+// separators of a region, given as FILE@OFFSET+LENGTH
+#define SFILE_MAP_AT		'@'
+#define SFILE_MAP_LEN		'+'
+
+int sfile_map_detect(char* path);
+int sfile_map_open(sfile* sf, char* path);
+int sfile_map_close(sfile* sf);
+int sfile_map_stat(sfile* sf, struct stat* buf);
+size_t sfile_map_read(sfile* sf, unsigned char* dst, size_t len);
+
+#endif /* _SBUF_MAP_H */
@@ -0,0 +1,731 @@
+/*
+ * sbuf_pipe - pipeline of reading, comparing and rendering
+ *
+ * Splits a comparison into three stages. The reader stage fills the file
+ * buffers and hands out windows of lines available in all files. The compare
+ * stage compares each window in batches with sbuf_diff_batch_cmp(). The
+ * render stage, which is the caller, takes each batch with sbuf_pipe_next()
+ * and gives it back with sbuf_pipe_release() once it has been printed.
+ *
+ * Without threads, the reader and compare stages run on demand within
+ * sbuf_pipe_next(), and the single window refers directly to the file
+ * buffers. With threads, the reader and compare stages each run on their own
+ * thread, connected to each other and to the render stage by lock-free
+ * single-producer single-consumer queues. Each window then has its own
+ * buffers, into which the reader copies the lines of the window, so that the
+ * file buffers can be refilled while earlier windows are still compared and
+ * printed.
+ *
+ * Each window includes the state of the files at the end of its buffers, so
+ * the render stage never touches the files while the reader is using them.
+ */
+
+#include <stdio.h>		// NULL
+#include <stdlib.h>		// malloc(), free()
+#include <string.h>		// memcpy()
+#include <pthread.h>		// pthread_create(), pthread_join()
+#include "mem.h"
+#include "sbuf.h"
+#include "sbuf_diff.h"
+#include "spsc.h"
+#include "sbuf_pipe.h"
+
+#define MAX_LINES		(size_t)-1	// no limit on lines
+
+/**********************************************************/
+/*
+ * Saves the state of each file in the given window, as if nothing had been
+ * read past the given end position. When threaded, the data of the file
+ * buffers between the position of the window and the end position is first
+ * copied into the buffers of the window.
+ */
+static void sbuf_pipe_snapshot(sbuf_pipe* p, sbuf_window* w, size_t end) {
+	int i;
+	sbuf* sb;
+	size_t start;
+	size_t stop;
+	size_t ahead;
+
+	for (i = 0; i < p->file_cnt; i++) {
+		sb = p->sb[i];
+
+		// state of file
+		w->sf[i] = *p->sf[i];
+
+		// window refers directly to the file buffers
+		if (! p->threads) {
+			continue;
+		}
+
+		// data of the window, after any NULL bytes before the buffer
+		start = (sb->pos > w->pos ? sb->pos : w->pos);
+		stop = sb->pos + sb->len;
+		if (stop > end) {
+			stop = end;
+		}
+
+		// copy data
+		w->sb[i]->pos = start;
+		w->sb[i]->len = 0;
+		if (stop > start) {
+			memcpy(w->sb[i]->ptr, sb->ptr + (start - sb->pos), stop - start);
+			w->sb[i]->len = stop - start;
+		}
+
+		// data read past the end position is not part of the window
+		stop = (sb->pos > end ? sb->pos : end);
+		ahead = 0;
+		if (sb->pos + sb->len > stop) {
+			ahead = (sb->pos + sb->len) - stop;
+		}
+		w->sf[i].offset -= ahead;
+		w->sf[i].bytes_read -= ahead;
+	}
+}
+
+/**********************************************************/
+/*
+ * Discards the rest of the data of the given file, the only one which is not
+ * end-of-output, once no more differences are possible. NULL bytes are not
+ * compared as different, so the lines after the end of all other files only
+ * need to be read for the lines of context after their last difference. The
+ * buffer is emptied and moved past the discarded data, up to the end
+ * position, which is then counted as NULL bytes before the buffer. Returns
+ * the number of bytes discarded.
+ */
+static size_t sbuf_pipe_skip(sbuf_pipe* p, int f) {
+	sbuf* sb;
+	size_t end;
+	size_t len;
+	int i;
+
+	// end of data of all other files
+	end = 0;
+	for (i = 0; i < p->file_cnt; i++) {
+		if (i != f && p->sb[i]->pos + p->sb[i]->len > end) {
+			end = p->sb[i]->pos + p->sb[i]->len;
+		}
+	}
+
+	// lines of context after the last difference are still printed
+	if (p->pos < end || (p->pos - end) / p->width < p->context) {
+		return 0;
+	}
+
+	// nothing to discard before the end position
+	sb = p->sb[f];
+	if (sb->pos + sb->len >= p->end_pos) {
+		return 0;
+	}
+	len = p->end_pos - (sb->pos + sb->len);
+
+	// empty the buffer, then move it past the discarded data
+	sbuf_reduce(sb, sb->pos + sb->len);
+	len = sfile_skip(p->sf[f], len);
+	sb->pos += len;
+
+	return len;
+}
+
+/**********************************************************/
+/*
+ * Ends the virtual files, which never end by themselves, once all other files
+ * are end-of-file. The data of virtual files after the end of the data of the
+ * other files is dropped, as if it had never been read, so that they end at
+ * the same position.
+ */
+static void sbuf_pipe_end_virtual(sbuf_pipe* p) {
+	sbuf* sb;
+	size_t end;
+	size_t cut;
+	int i;
+
+	// end of data of all other files, unless one is not end-of-file
+	end = 0;
+	for (i = 0; i < p->file_cnt; i++) {
+		if (p->sf[i]->pat_len == 0) {
+			if (! p->sf[i]->eof) {
+				return;
+			}
+			if (p->sb[i]->pos + p->sb[i]->len > end) {
+				end = p->sb[i]->pos + p->sb[i]->len;
+			}
+		}
+	}
+
+	// loop through virtual files
+	for (i = 0; i < p->file_cnt; i++) {
+		sb = p->sb[i];
+		if (p->sf[i]->pat_len == 0 || p->sf[i]->eof) {
+			continue;
+		}
+
+		// drop data after the end
+		cut = 0;
+		if (sb->pos >= end) {
+			cut = sb->len;
+			sb->pos = end;
+		}
+		else if (sb->pos + sb->len > end) {
+			cut = (sb->pos + sb->len) - end;
+		}
+		sb->len -= cut;
+		p->sf[i]->offset -= cut;
+		p->sf[i]->bytes_read -= cut;
+		p->sf[i]->eof = 1;
+	}
+}
+
+/**********************************************************/
+/*
+ * Reader stage. Fills the file buffers until at least one line is available
+ * in each file, then sets the given window to all of the lines available in
+ * all files. The window is marked as the end of output if all files are
+ * end-of-output, the end position was reached or the pipeline was stopped.
+ */
+static void sbuf_pipe_fill(sbuf_pipe* p, sbuf_window* w) {
+	int i;
+	int eoo_cnt;
+	size_t lines;
+	size_t tmp;
+	ssize_t br;
+
+	// assume end of output
+	w->pos = p->pos;
+	w->len = 0;
+	w->lines = 0;
+	w->done = 0;
+	w->end = 1;
+
+	// stopped, close files immediately, nothing more is read
+	if (atomic_load(&p->stop)) {
+		for (i = 0; i < p->file_cnt; i++) {
+			if (sfile_close(p->sf[i]) != 0) {
+				p->error = 1;
+			}
+		}
+		sbuf_pipe_snapshot(p, w, w->pos);
+		return;
+	}
+
+	// end position was reached
+	if (p->done) {
+		sbuf_pipe_snapshot(p, w, w->pos);
+		return;
+	}
+
+	// attempt to re-read from files of unknown size (such as STDIN and
+	// pipes) solely to determine if EOF has been reached, otherwise if last
+	// read was the exact size of the buffer there is no way to know if EOF
+	// was reached, files of known size are end-of-file once fully read
+	if (p->probe) {
+		for (i = 0; i < p->file_cnt; i++) {
+			if (p->sf[i]->size < 0) {
+				sfile_read(p->sf[i], p->sb[i]);
+			}
+		}
+	}
+	p->probe = 1;
+
+	// assume files are not end-of-output
+	eoo_cnt = 0;
+
+	// loop through files
+	for (i = 0; i < p->file_cnt; i++) {
+
+		// ensure there is enough data in the buffer
+		while (! p->sf[i]->eof && sbuf_avail(p->sb[i], p->pos) < p->width) {
+
+			// shift/reduce buffer
+			sbuf_reduce(p->sb[i], p->pos);
+
+			// read more data from file
+			br = sfile_read(p->sf[i], p->sb[i]);
+			if (br < 0) {
+				break;
+			}
+		}
+	}
+
+	// virtual files end with the other files
+	sbuf_pipe_end_virtual(p);
+
+	// loop through files
+	for (i = 0; i < p->file_cnt; i++) {
+
+		// end of output
+		if (sfile_eoo(p->sf[i], p->sb[i], p->pos) != 0) {
+			eoo_cnt++;
+		}
+	}
+
+	// only one file is left and no more differences are possible, skip its
+	// data instead of reading it
+	if (p->skip && p->file_cnt > 1 && eoo_cnt == p->file_cnt - 1) {
+		for (i = 0; i < p->file_cnt; i++) {
+			if (sfile_eoo(p->sf[i], p->sb[i], p->pos) == 0) {
+				if (sbuf_pipe_skip(p, i) > 0 && sfile_eoo(p->sf[i], p->sb[i], p->pos) != 0) {
+					eoo_cnt++;
+				}
+				break;
+			}
+		}
+	}
+
+	// all files are end-of-output
+	if (eoo_cnt == p->file_cnt) {
+		sbuf_pipe_snapshot(p, w, w->pos);
+		return;
+	}
+
+	// determine the number of lines available in all buffers
+	lines = MAX_LINES;
+	tmp = 0;
+	for (i = 0; i < p->file_cnt; i++) {
+
+		// limited by the data read so far
+		if (! p->sf[i]->eof) {
+			if (sbuf_avail(p->sb[i], p->pos) / p->width < lines) {
+				lines = sbuf_avail(p->sb[i], p->pos) / p->width;
+			}
+		}
+
+		// end of data for end-of-file
+		else if (p->sb[i]->pos + p->sb[i]->len > tmp) {
+			tmp = p->sb[i]->pos + p->sb[i]->len;
+		}
+	}
+
+	// all files are end-of-file, include a partial last line
+	if (lines == MAX_LINES) {
+		tmp -= p->pos;
+		lines = (tmp / p->width) + (tmp % p->width > 0 ? 1 : 0);
+	}
+
+	// always process at least one line
+	if (lines == 0) {
+		lines = 1;
+	}
+
+	// limited by length, include a partial last line
+	tmp = p->end_pos - p->pos;
+	if ((tmp / p->width) + (tmp % p->width > 0 ? 1 : 0) < lines) {
+		lines = (tmp / p->width) + (tmp % p->width > 0 ? 1 : 0);
+	}
+	if (lines * p->width < tmp) {
+		tmp = lines * p->width;
+	}
+
+	// set window
+	w->len = tmp;
+	w->lines = lines;
+	w->end = 0;
+	sbuf_pipe_snapshot(p, w, w->pos + lines * p->width);
+
+	// next window, unless the end position was reached
+	if (lines * p->width >= p->end_pos - p->pos) {
+		p->done = 1;
+	}
+	else {
+		p->pos += lines * p->width;
+	}
+}
+
+/**********************************************************/
+/*
+ * Compare stage. Compares the next lines of the given window into the given
+ * batch, as many as fit into the batch. The batch is marked as the last of
+ * the window once all lines of the window have been compared.
+ */
+static void sbuf_pipe_compare(sbuf_pipe* p, sbuf_window* w, sbuf_pipe_batch* pb) {
+	sbuf_diff_batch* b;
+	size_t pos;
+
+	b = pb->batch;
+	pb->w = w;
+
+	// position of the next lines
+	pos = w->pos + (w->done * p->width);
+
+	// end of output, no lines
+	if (w->end) {
+		b->pos = pos;
+		b->lines = 0;
+		b->cnt = 0;
+	}
+
+	// stopped, remaining lines are not rendered
+	else if (atomic_load(&p->stop)) {
+		b->pos = pos;
+		b->lines = w->lines - w->done;
+		b->cnt = 0;
+	}
+
+	// compare all remaining lines at once
+	else if (p->file_cnt > 1) {
+		sbuf_diff_batch_cmp(b, w->sb, p->file_cnt, pos, w->len - (w->done * p->width), &p->word, p->ignore);
+	}
+
+	// nothing to compare
+	else {
+		b->pos = pos;
+		b->lines = w->lines - w->done;
+		b->cnt = 0;
+	}
+
+	w->done += b->lines;
+	pb->last = (w->done >= w->lines);
+}
+
+/**********************************************************/
+/*
+ * Reader thread. Fills each window returned by the render stage and passes it
+ * to the compare stage, until the end of output.
+ */
+static void* sbuf_pipe_reader(void* arg) {
+	sbuf_pipe* p;
+	sbuf_window* w;
+	int end;
+
+	p = (sbuf_pipe*)arg;
+
+	do {
+		w = (sbuf_window*)spsc_pop_wait(p->win_free);
+		sbuf_pipe_fill(p, w);
+
+		// window belongs to the next stage once passed on
+		end = w->end;
+		spsc_push_wait(p->win_full, w);
+	} while (! end);
+
+	return NULL;
+}
+
+/**********************************************************/
+/*
+ * Compare thread. Compares each window from the reader stage in as many
+ * batches as necessary and passes the batches to the render stage, until the
+ * end of output.
+ */
+static void* sbuf_pipe_comparer(void* arg) {
+	sbuf_pipe* p;
+	sbuf_window* w;
+	sbuf_pipe_batch* pb;
+	int end;
+	int last;
+
+	p = (sbuf_pipe*)arg;
+
+	do {
+		w = (sbuf_window*)spsc_pop_wait(p->win_full);
+		end = w->end;
+
+		do {
+			pb = (sbuf_pipe_batch*)spsc_pop_wait(p->pb_free);
+			sbuf_pipe_compare(p, w, pb);
+
+			// batch belongs to the next stage once passed on
+			last = pb->last;
+			spsc_push_wait(p->pb_full, pb);
+		} while (! last);
+	} while (! end);
+
+	return NULL;
+}
+
+/**********************************************************/
+/*
+ * Allocates memory and initializes a new pipeline for the given files and
+ * file buffers, comparing lines of the given width in batches of at most
+ * max_cnt differing lines. If threads is non-zero, the reader and compare
+ * stages run on separate threads once started. Returns the new structure, or
+ * NULL if error.
+ */
+sbuf_pipe* sbuf_pipe_malloc(sfile** sf, sbuf** sb, int file_cnt, size_t width, size_t max_cnt, int threads) {
+	sbuf_pipe* p;
+	int i;
+	int j;
+
+	// check parameters
+	if (sf == NULL || sb == NULL || file_cnt <= 0 || width == 0) {
+		return NULL;
+	}
+
+	// allocate memory for structure
+	p = (sbuf_pipe*)calloc(1, sizeof(sbuf_pipe));
+	if (p == NULL) {
+		return NULL;
+	}
+
+	// set default values
+	p->sf = sf;
+	p->sb = sb;
+	p->file_cnt = file_cnt;
+	p->width = width;
+	sbuf_diff_word_init(&p->word, 1, 0);
+	p->ignore = NULL;
+	p->nbd = 0;
+	p->skip = 0;
+	p->context = 0;
+	p->error = 0;
+	p->threads = threads;
+	atomic_init(&p->stop, 0);
+
+	// number of windows and batches in flight
+	p->win_cnt = 1;
+	p->pb_cnt = 1;
+	if (threads) {
+		p->win_cnt = SBUF_PIPE_WINDOWS;
+		p->pb_cnt = SBUF_PIPE_BATCHES;
+	}
+
+	// allocate windows
+	p->win = (sbuf_window*)calloc(p->win_cnt, sizeof(sbuf_window));
+	if (p->win == NULL) {
+		sbuf_pipe_free(p);
+		return NULL;
+	}
+
+	// one arena for the buffers of all windows
+	if (threads) {
+		p->arena = mem_arena_malloc(p->win_cnt * file_cnt * (sb[0]->size + (2 * MEM_ALIGN)));
+		if (p->arena == NULL) {
+			sbuf_pipe_free(p);
+			return NULL;
+		}
+	}
+	for (i = 0; i < p->win_cnt; i++) {
+		p->win[i].sb = (sbuf**)calloc(file_cnt, sizeof(sbuf*));
+		p->win[i].sf = (sfile*)calloc(file_cnt, sizeof(sfile));
+		if (p->win[i].sb == NULL || p->win[i].sf == NULL) {
+			sbuf_pipe_free(p);
+			return NULL;
+		}
+
+		// window buffers
+		for (j = 0; j < file_cnt; j++) {
+			if (threads) {
+				p->win[i].sb[j] = sbuf_malloc_arena(p->arena, sb[j]->size, 1);
+				if (p->win[i].sb[j] == NULL) {
+					sbuf_pipe_free(p);
+					return NULL;
+				}
+			}
+			else {
+				p->win[i].sb[j] = sb[j];
+			}
+		}
+	}
+
+	// allocate batches
+	p->pb = (sbuf_pipe_batch*)calloc(p->pb_cnt, sizeof(sbuf_pipe_batch));
+	if (p->pb == NULL) {
+		sbuf_pipe_free(p);
+		return NULL;
+	}
+	for (i = 0; i < p->pb_cnt; i++) {
+		p->pb[i].batch = sbuf_diff_batch_malloc(width, max_cnt);
+		if (p->pb[i].batch == NULL) {
+			sbuf_pipe_free(p);
+			return NULL;
+		}
+	}
+
+	// allocate queues
+	if (threads) {
+		p->win_free = spsc_malloc(p->win_cnt);
+		p->win_full = spsc_malloc(p->win_cnt);
+		p->pb_free = spsc_malloc(p->pb_cnt);
+		p->pb_full = spsc_malloc(p->pb_cnt);
+		if (p->win_free == NULL || p->win_full == NULL || p->pb_free == NULL || p->pb_full == NULL) {
+			sbuf_pipe_free(p);
+			return NULL;
+		}
+	}
+
+	return p;
+}
+
+/**********************************************************/
+/*
+ * Frees all memory associated with the given pipeline, waiting for the
+ * threads to finish if they were started. The threads only finish at the end
+ * of output, so all batches up to the end must have been taken first. The
+ * files and file buffers are not freed. Returns 0 if successful, or -1 if a
+ * file could not be closed when the pipeline was stopped.
+ */
+int sbuf_pipe_free(sbuf_pipe* p) {
+	int i;
+	int ret;
+
+	// check parameters
+	if (p == NULL) {
+		return 0;
+	}
+
+	// wait for threads
+	if (p->started) {
+		pthread_join(p->reader, NULL);
+		pthread_join(p->comparer, NULL);
+	}
+
+	// free windows
+	if (p->win != NULL) {
+		for (i = 0; i < p->win_cnt; i++) {
+			free(p->win[i].sb);
+			free(p->win[i].sf);
+		}
+		free(p->win);
+	}
+	mem_arena_free(p->arena);
+
+	// free batches
+	if (p->pb != NULL) {
+		for (i = 0; i < p->pb_cnt; i++) {
+			sbuf_diff_batch_free(p->pb[i].batch);
+		}
+		free(p->pb);
+	}
+
+	// free queues
+	spsc_free(p->win_free);
+	spsc_free(p->win_full);
+	spsc_free(p->pb_free);
+	spsc_free(p->pb_full);
+
+	ret = (p->error ? -1 : 0);
+	free(p);
+
+	return ret;
+}
+
+/**********************************************************/
+/*
+ * Starts the pipeline at the given position, ending at the given end position.
+ * The file buffers must already hold the data of the first read. The word
+ * comparator, ignored differences and NULL byte flag must be set beforehand.
+ * Once the end of output was taken, the pipeline can be started again for
+ * another range of the files, unless it was stopped. Returns 0 if successful,
+ * or -1 if error.
+ */
+int sbuf_pipe_start(sbuf_pipe* p, size_t pos, size_t end_pos) {
+	int i;
+
+	// check parameters
+	if (p == NULL) {
+		return -1;
+	}
+
+	// wait for the threads of the previous range, then take back the
+	// windows and batches left in the queues
+	if (p->started) {
+		pthread_join(p->reader, NULL);
+		pthread_join(p->comparer, NULL);
+		p->started = 0;
+		while (spsc_pop(p->win_free) != NULL) {
+		}
+		while (spsc_pop(p->win_full) != NULL) {
+		}
+		while (spsc_pop(p->pb_free) != NULL) {
+		}
+		while (spsc_pop(p->pb_full) != NULL) {
+		}
+	}
+
+	// set default values
+	p->pos = pos;
+	p->end_pos = end_pos;
+	p->probe = 0;
+	p->done = 0;
+	for (i = 0; i < p->pb_cnt; i++) {
+		p->pb[i].batch->nbd = p->nbd;
+		if (sbuf_diff_batch_mask(p->pb[i].batch, &p->word) != 0) {
+			return -1;
+		}
+	}
+
+	// stages run on demand
+	if (! p->threads) {
+		return 0;
+	}
+
+	// all windows and batches are available
+	for (i = 0; i < p->win_cnt; i++) {
+		spsc_push(p->win_free, &p->win[i]);
+	}
+	for (i = 0; i < p->pb_cnt; i++) {
+		spsc_push(p->pb_free, &p->pb[i]);
+	}
+
+	// start threads
+	if (pthread_create(&p->reader, NULL, sbuf_pipe_reader, p) != 0) {
+		return -1;
+	}
+	if (pthread_create(&p->comparer, NULL, sbuf_pipe_comparer, p) != 0) {
+		atomic_store(&p->stop, 1);
+		pthread_join(p->reader, NULL);
+		return -1;
+	}
+	p->started = 1;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Returns the next batch of compared lines, waiting for it if threaded. The
+ * last batch is marked as the end of output by its window, and has no lines.
+ * Each batch must be given back with sbuf_pipe_release() before the next one
+ * is taken.
+ */
+sbuf_pipe_batch* sbuf_pipe_next(sbuf_pipe* p) {
+	sbuf_window* w;
+	sbuf_pipe_batch* pb;
+
+	// compared by the compare thread
+	if (p->threads) {
+		return (sbuf_pipe_batch*)spsc_pop_wait(p->pb_full);
+	}
+
+	// fill the window once all of its lines have been compared
+	w = &p->win[0];
+	pb = &p->pb[0];
+	if (w->done >= w->lines) {
+		sbuf_pipe_fill(p, w);
+	}
+	sbuf_pipe_compare(p, w, pb);
+
+	return pb;
+}
+
+/**********************************************************/
+/*
+ * Gives back the given batch, along with its window if it is the last batch
+ * of the window, once the render stage is done with them.
+ */
+void sbuf_pipe_release(sbuf_pipe* p, sbuf_pipe_batch* pb) {
+
+	// nothing to give back without threads
+	if (! p->threads) {
+		return;
+	}
+
+	// window is refilled unless it was the end, which the reader never
+	// waits for
+	if (pb->last && ! pb->w->end) {
+		spsc_push_wait(p->win_free, pb->w);
+	}
+	spsc_push_wait(p->pb_free, pb);
+}
+
+/**********************************************************/
+/*
+ * Stops reading as soon as possible, such as when a limit was reached. The
+ * files are closed by the reader stage. Batches already in flight are still
+ * returned by sbuf_pipe_next() until the end of output.
+ */
+void sbuf_pipe_stop(sbuf_pipe* p) {
+	atomic_store(&p->stop, 1);
+}
+
+/**********************************************************/
@@ -0,0 +1,75 @@
+#ifndef _SBUF_PIPE_H
+#define _SBUF_PIPE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "mem.h"
+#include "sbuf.h"
+#include "sbuf_diff.h"
+#include "llq.h"
+#include "spsc.h"
+
+#define SBUF_PIPE_WINDOWS	4	// windows in flight when threaded
+#define SBUF_PIPE_BATCHES	8	// batches in flight when threaded
+
+// lines of all files available at once
+struct sbuf_window {
+	sbuf** sb;		// buffer of each file
+	sfile* sf;		// state of each file at the end of the buffers
+	size_t pos;		// position of the first line
+	size_t len;		// number of bytes, limited by the end position
+	size_t lines;		// number of lines, including a partial last line
+	size_t done;		// number of lines compared so far
+	int end;		// flag to mark the end of output (no lines)
+};
+typedef struct sbuf_window sbuf_window;
+
+// compared lines of a window
+struct sbuf_pipe_batch {
+	sbuf_diff_batch* batch;	// differences of the compared lines
+	sbuf_window* w;		// window of the compared lines
+	int last;		// flag to mark the last batch of the window
+};
+typedef struct sbuf_pipe_batch sbuf_pipe_batch;
+
+// pipeline
+struct sbuf_pipe {
+	sfile** sf;		// files
+	sbuf** sb;		// file buffers, used by the reader only
+	int file_cnt;		// number of files
+	size_t width;		// number of bytes per line per file
+	sbuf_diff_word word;	// word size and byte order of difference groups
+	llq_list* ignore;	// differences to ignore
+	int nbd;		// NULL bytes are compared as different
+	int skip;		// flag to skip the data of the last file left
+	size_t context;		// lines of context printed after a difference
+	size_t pos;		// position of the next window
+	size_t end_pos;		// ending position of output
+	int probe;		// flag to re-read before the next window
+	int done;		// flag to mark the end position was reached
+	atomic_int stop;	// flag to stop reading as soon as possible
+	int error;		// flag to mark a file could not be closed when stopped
+	int threads;		// flag to run the stages on separate threads
+	int started;		// flag to mark the threads were started
+	sbuf_window* win;	// windows
+	mem_arena* arena;	// buffers of the windows, when threaded
+	int win_cnt;		// number of windows
+	sbuf_pipe_batch* pb;	// batches
+	int pb_cnt;		// number of batches
+	spsc* win_free;		// windows returned by the render stage
+	spsc* win_full;		// windows filled by the reader stage
+	spsc* pb_free;		// batches returned by the render stage
+	spsc* pb_full;		// batches compared by the compare stage
+	pthread_t reader;	// reader thread
+	pthread_t comparer;	// compare thread
+};
+typedef struct sbuf_pipe sbuf_pipe;
+
+sbuf_pipe* sbuf_pipe_malloc(sfile** sf, sbuf** sb, int file_cnt, size_t width, size_t max_cnt, int threads);
+int sbuf_pipe_free(sbuf_pipe* p);
+int sbuf_pipe_start(sbuf_pipe* p, size_t pos, size_t end_pos);
+sbuf_pipe_batch* sbuf_pipe_next(sbuf_pipe* p);
+void sbuf_pipe_release(sbuf_pipe* p, sbuf_pipe_batch* pb);
+void sbuf_pipe_stop(sbuf_pipe* p);
+
+#endif /* _SBUF_PIPE_H */
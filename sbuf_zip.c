@@ -0,0 +1,410 @@
+/*
+ * sbuf_zip - compressed file input
+ *
+ * Provides transparent decompression of gzip and zstd files for the file
+ * structure. A compressed file is detected by its magic number and is then
+ * decompressed by a separate thread into a pipe. The read end of the pipe
+ * replaces the file descriptor of the file structure, so decompression
+ * overlaps with reading and comparing the data. Each format is only
+ * supported if its library was found at build time (HAVE_ZLIB, HAVE_ZSTD),
+ * otherwise the file is read as is.
+ */
+
+#include <stdio.h>		// NULL, fprintf()
+#include <stdlib.h>		// malloc(), free()
+#include <unistd.h>		// read(), write(), pread(), close(), pipe()
+#include <fcntl.h>		// fcntl()
+#include <errno.h>		// errno
+#include <signal.h>		// sigset_t, sigemptyset(), sigaddset()
+#include <pthread.h>		// pthread_create(), pthread_join()
+#ifdef HAVE_ZLIB
+#include <zlib.h>		// inflate()
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>		// ZSTD_decompressStream()
+#endif
+#include "sbuf.h"
+#include "sbuf_zip.h"
+
+#define ZIP_BUF_SIZE		(size_t)131072	// size of each I/O buffer
+#define ZIP_PIPE_SIZE		1048576		// requested pipe capacity
+
+struct sfile_zip {
+	pthread_t thread;	// decompression thread
+	int type;		// compression type
+	int in;			// compressed file descriptor
+	int out;		// write end of pipe
+	int error;		// flag to mark a decompression error
+	unsigned char* ibuf;	// compressed data buffer
+	unsigned char* obuf;	// decompressed data buffer
+};
+typedef struct sfile_zip sfile_zip;
+
+/**********************************************************/
+/*
+ * Returns the compression type of the given file according to the magic
+ * number at the beginning of the file. The file offset is not changed. Returns
+ * SFILE_ZIP_NONE for files that cannot be read with pread(), such as STDIN.
+ */
+int sfile_zip_detect(int fd) {
+	unsigned char magic[4];
+	ssize_t br;
+
+	// read magic number without changing offset
+	br = pread(fd, magic, sizeof(magic), 0);
+
+	// gzip
+	if (br >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+		return SFILE_ZIP_GZIP;
+	}
+
+	// zstd
+	if (br >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+		return SFILE_ZIP_ZSTD;
+	}
+
+	return SFILE_ZIP_NONE;
+}
+
+/**********************************************************/
+/*
+ * Returns 1 if the given compression type can be decompressed, or 0 if the
+ * library was not available at build time.
+ */
+int sfile_zip_supported(int type) {
+
+#ifdef HAVE_ZLIB
+	if (type == SFILE_ZIP_GZIP) {
+		return 1;
+	}
+#endif
+#ifdef HAVE_ZSTD
+	if (type == SFILE_ZIP_ZSTD) {
+		return 1;
+	}
+#endif
+
+	return 0;
+}
+
+/**********************************************************/
+#if defined(HAVE_ZLIB) || defined(HAVE_ZSTD)
+/*
+ * Writes all of the given data to the pipe. Returns 0 if successful, or -1 if
+ * error, including when the read end of the pipe has been closed.
+ */
+static int sfile_zip_write(sfile_zip* z, unsigned char* buf, size_t len) {
+	ssize_t bw;
+
+	while (len > 0) {
+		bw = write(z->out, buf, len);
+		if (bw < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		buf += bw;
+		len -= bw;
+	}
+
+	return 0;
+}
+#endif
+
+/**********************************************************/
+#ifdef HAVE_ZLIB
+/*
+ * Decompresses a gzip file into the pipe, including files with multiple
+ * concatenated members. Returns 0 if successful, 1 if the read end of the
+ * pipe was closed, or -1 if error.
+ */
+static int sfile_zip_gzip(sfile_zip* z) {
+	z_stream strm;
+	ssize_t br;
+	int ret;
+	int ended;
+
+	// initialize for gzip with automatic header detection
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	strm.next_in = Z_NULL;
+	strm.avail_in = 0;
+	if (inflateInit2(&strm, 15 + 32) != Z_OK) {
+		return -1;
+	}
+
+	ended = 0;
+	ret = Z_OK;
+	while ((br = read(z->in, z->ibuf, ZIP_BUF_SIZE)) != 0) {
+
+		// read error
+		if (br < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			inflateEnd(&strm);
+			return -1;
+		}
+
+		strm.next_in = z->ibuf;
+		strm.avail_in = br;
+		do {
+
+			// start of the next concatenated member
+			if (ended && strm.avail_in > 0) {
+				inflateReset(&strm);
+				ended = 0;
+			}
+
+			// decompress as much as possible
+			strm.next_out = z->obuf;
+			strm.avail_out = ZIP_BUF_SIZE;
+			ret = inflate(&strm, Z_NO_FLUSH);
+			if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+				inflateEnd(&strm);
+				return -1;
+			}
+			if (ret == Z_STREAM_END) {
+				ended = 1;
+			}
+
+			// pass decompressed data to the pipe
+			if (sfile_zip_write(z, z->obuf, ZIP_BUF_SIZE - strm.avail_out) < 0) {
+				inflateEnd(&strm);
+				return 1;
+			}
+
+			// no progress without more input
+			if (ret == Z_BUF_ERROR) {
+				break;
+			}
+		} while (strm.avail_in > 0 || strm.avail_out == 0);
+	}
+
+	inflateEnd(&strm);
+
+	// truncated file
+	if (! ended) {
+		return -1;
+	}
+
+	return 0;
+}
+#endif
+
+/**********************************************************/
+#ifdef HAVE_ZSTD
+/*
+ * Decompresses a zstd file into the pipe, including files with multiple
+ * concatenated frames. Returns 0 if successful, 1 if the read end of the pipe
+ * was closed, or -1 if error.
+ */
+static int sfile_zip_zstd(sfile_zip* z) {
+	ZSTD_DCtx* dctx;
+	ZSTD_inBuffer input;
+	ZSTD_outBuffer output;
+	ssize_t br;
+	size_t ret;
+
+	dctx = ZSTD_createDCtx();
+	if (dctx == NULL) {
+		return -1;
+	}
+
+	ret = 0;
+	while ((br = read(z->in, z->ibuf, ZIP_BUF_SIZE)) != 0) {
+
+		// read error
+		if (br < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			ZSTD_freeDCtx(dctx);
+			return -1;
+		}
+
+		input.src = z->ibuf;
+		input.size = br;
+		input.pos = 0;
+		do {
+
+			// decompress as much as possible
+			output.dst = z->obuf;
+			output.size = ZIP_BUF_SIZE;
+			output.pos = 0;
+			ret = ZSTD_decompressStream(dctx, &output, &input);
+			if (ZSTD_isError(ret)) {
+				ZSTD_freeDCtx(dctx);
+				return -1;
+			}
+
+			// pass decompressed data to the pipe
+			if (sfile_zip_write(z, z->obuf, output.pos) < 0) {
+				ZSTD_freeDCtx(dctx);
+				return 1;
+			}
+		} while (input.pos < input.size || output.pos == output.size);
+	}
+
+	ZSTD_freeDCtx(dctx);
+
+	// truncated file
+	if (ret != 0) {
+		return -1;
+	}
+
+	return 0;
+}
+#endif
+
+/**********************************************************/
+/*
+ * Decompression thread. Writes the decompressed data of the compressed file to
+ * the pipe and closes both when done. SIGPIPE is blocked so that closing the
+ * read end of the pipe early only stops this thread.
+ */
+static void* sfile_zip_thread(void* arg) {
+	sfile_zip* z;
+	sigset_t set;
+	int ret;
+
+	z = (sfile_zip*)arg;
+
+	// do not terminate the program if the reader stops early
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	// decompress
+	ret = -1;
+#ifdef HAVE_ZLIB
+	if (z->type == SFILE_ZIP_GZIP) {
+		ret = sfile_zip_gzip(z);
+	}
+#endif
+#ifdef HAVE_ZSTD
+	if (z->type == SFILE_ZIP_ZSTD) {
+		ret = sfile_zip_zstd(z);
+	}
+#endif
+	if (ret < 0) {
+		z->error = 1;
+		fprintf(stderr, "Could not decompress file, data is truncated.\n");
+	}
+
+	// signal end-of-file to the reader
+	close(z->out);
+	close(z->in);
+
+	return NULL;
+}
+
+/**********************************************************/
+/*
+ * Checks if the given open file is compressed and starts decompressing it on a
+ * separate thread. The file descriptor of the file structure is replaced with
+ * the read end of a pipe which provides the decompressed data. Returns 1 if
+ * the file is decompressed, 0 if the file is not compressed or the format is
+ * not supported, or -1 if error.
+ */
+int sfile_zip_open(sfile* sf) {
+	sfile_zip* z;
+	int type;
+	int fds[2];
+
+	// check parameters
+	if (sf == NULL || sf->fd < 0 || sf->zip != NULL) {
+		return -1;
+	}
+
+	// not compressed, or read as is
+	type = sfile_zip_detect(sf->fd);
+	if (type == SFILE_ZIP_NONE || ! sfile_zip_supported(type)) {
+		return 0;
+	}
+
+	// allocate memory for structure
+	z = (sfile_zip*)malloc(sizeof(sfile_zip));
+	if (z == NULL) {
+		return -1;
+	}
+
+	// allocate memory for buffers
+	z->ibuf = (unsigned char*)malloc(sizeof(unsigned char) * ZIP_BUF_SIZE);
+	z->obuf = (unsigned char*)malloc(sizeof(unsigned char) * ZIP_BUF_SIZE);
+	if (z->ibuf == NULL || z->obuf == NULL) {
+		free(z->ibuf);
+		free(z->obuf);
+		free(z);
+		return -1;
+	}
+
+	// create pipe
+	if (pipe(fds) < 0) {
+		free(z->ibuf);
+		free(z->obuf);
+		free(z);
+		return -1;
+	}
+
+#ifdef F_SETPIPE_SZ
+	// larger pipe to reduce context switches, failure is harmless
+	fcntl(fds[1], F_SETPIPE_SZ, ZIP_PIPE_SIZE);
+#endif
+
+	// set values
+	z->type = type;
+	z->in = sf->fd;
+	z->out = fds[1];
+	z->error = 0;
+
+	// start decompression
+	if (pthread_create(&z->thread, NULL, sfile_zip_thread, z) != 0) {
+		close(fds[0]);
+		close(fds[1]);
+		free(z->ibuf);
+		free(z->obuf);
+		free(z);
+		return -1;
+	}
+
+	// read decompressed data from pipe
+	sf->fd = fds[0];
+	sf->zip = z;
+
+	return 1;
+}
+
+/**********************************************************/
+/*
+ * Waits for the decompression thread of the given file to finish and frees
+ * its resources. The read end of the pipe must already be closed so that the
+ * thread stops even if not all data was read. Returns 0 if successful, or -1
+ * if the data could not be decompressed.
+ */
+int sfile_zip_close(sfile* sf) {
+	sfile_zip* z;
+	int error;
+
+	// check parameters
+	if (sf == NULL || sf->zip == NULL) {
+		return 0;
+	}
+
+	// wait for thread
+	z = sf->zip;
+	pthread_join(z->thread, NULL);
+	error = z->error;
+
+	// free memory
+	free(z->ibuf);
+	free(z->obuf);
+	free(z);
+	sf->zip = NULL;
+
+	return (error ? -1 : 0);
+}
+
+/**********************************************************/
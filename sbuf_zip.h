@@ -0,0 +1,16 @@
+#ifndef _SBUF_ZIP_H
+#define _SBUF_ZIP_H
+
+#include "sbuf.h"
+
+// compression types
+#define SFILE_ZIP_NONE		0
+#define SFILE_ZIP_GZIP		1
+#define SFILE_ZIP_ZSTD		2
+
+int sfile_zip_detect(int fd);
+int sfile_zip_supported(int type);
+int sfile_zip_open(sfile* sf);
+int sfile_zip_close(sfile* sf);
+
+#endif /* _SBUF_ZIP_H */
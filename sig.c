@@ -0,0 +1,493 @@
+/*
+ * sig - block signatures
+ *
+ * Provides signatures of files, made of a strong hash of each block of a file,
+ * so that a file can be verified without the file it is compared to. A
+ * signature is generated from the reference, and the target is verified by
+ * reading it once and comparing the hash of each block, which reports the
+ * blocks that differ. Those blocks can then be compared with the reference,
+ * wherever it is available, as a list of ranges.
+ *
+ * Blocks are hashed with BLAKE2b (RFC 7693) with a 32 byte digest. The blocks
+ * of each buffer of the file are hashed in parallel by a pool of worker
+ * threads, if any, so that hashing keeps up with reading.
+ *
+ * A signature file starts with a header of the magic string, the block size,
+ * the length of the file and the hash length, each as a little-endian 64-bit
+ * value after the magic string, followed by the hash of each block in order.
+ */
+
+#include <stdio.h>		// NULL, fopen(), fread(), fwrite(), fseek(), fclose(), fprintf()
+#include <stdlib.h>		// malloc(), free()
+#include <string.h>		// memcpy(), memcmp(), memset()
+#include <stdint.h>		// uint64_t
+#include "mem.h"
+#include "sbuf.h"
+#include "pool.h"
+#include "range.h"
+#include "sig.h"
+
+// initialization vector of BLAKE2b
+static const uint64_t sig_iv[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+// message word permutation of each round of BLAKE2b
+static const unsigned char sig_sigma[12][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+	{ 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+	{ 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+	{ 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+	{ 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+	{ 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+	{ 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+	{ 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+	{ 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 }
+};
+
+#define SIG_ROTR(x, n)		(((x) >> (n)) | ((x) << (64 - (n))))
+
+// mixing function of BLAKE2b
+#define SIG_G(a, b, c, d, x, y)				\
+	do {						\
+		v[a] = v[a] + v[b] + (x);		\
+		v[d] = SIG_ROTR(v[d] ^ v[a], 32);	\
+		v[c] = v[c] + v[d];			\
+		v[b] = SIG_ROTR(v[b] ^ v[c], 24);	\
+		v[a] = v[a] + v[b] + (y);		\
+		v[d] = SIG_ROTR(v[d] ^ v[a], 16);	\
+		v[c] = v[c] + v[d];			\
+		v[b] = SIG_ROTR(v[b] ^ v[c], 63);	\
+	} while (0)
+
+/**********************************************************/
+/*
+ * Returns the little-endian 64-bit value at the given memory.
+ */
+static uint64_t sig_load64(const unsigned char* p) {
+	uint64_t v;
+	int i;
+
+	v = 0;
+	for (i = 7; i >= 0; i--) {
+		v = (v << 8) | p[i];
+	}
+
+	return v;
+}
+
+/**********************************************************/
+/*
+ * Stores the given value at the given memory as a little-endian 64-bit value.
+ */
+static void sig_store64(unsigned char* p, uint64_t v) {
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		p[i] = (unsigned char)(v >> (8 * i));
+	}
+}
+
+/**********************************************************/
+/*
+ * Compresses the given 128 byte block into the given BLAKE2b state, with the
+ * given number of bytes hashed so far including the block, and the flag for
+ * the last block.
+ */
+static void sig_compress(uint64_t* h, const unsigned char* block, uint64_t t, int last) {
+	uint64_t v[16];
+	uint64_t m[16];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		m[i] = sig_load64(block + (8 * i));
+	}
+	for (i = 0; i < 8; i++) {
+		v[i] = h[i];
+		v[i + 8] = sig_iv[i];
+	}
+	v[12] ^= t;
+	if (last) {
+		v[14] = ~v[14];
+	}
+
+	// mix the columns, then the diagonals
+	for (i = 0; i < 12; i++) {
+		SIG_G(0, 4, 8, 12, m[sig_sigma[i][0]], m[sig_sigma[i][1]]);
+		SIG_G(1, 5, 9, 13, m[sig_sigma[i][2]], m[sig_sigma[i][3]]);
+		SIG_G(2, 6, 10, 14, m[sig_sigma[i][4]], m[sig_sigma[i][5]]);
+		SIG_G(3, 7, 11, 15, m[sig_sigma[i][6]], m[sig_sigma[i][7]]);
+		SIG_G(0, 5, 10, 15, m[sig_sigma[i][8]], m[sig_sigma[i][9]]);
+		SIG_G(1, 6, 11, 12, m[sig_sigma[i][10]], m[sig_sigma[i][11]]);
+		SIG_G(2, 7, 8, 13, m[sig_sigma[i][12]], m[sig_sigma[i][13]]);
+		SIG_G(3, 4, 9, 14, m[sig_sigma[i][14]], m[sig_sigma[i][15]]);
+	}
+
+	for (i = 0; i < 8; i++) {
+		h[i] ^= v[i] ^ v[i + 8];
+	}
+}
+
+/**********************************************************/
+/*
+ * Hashes len bytes of the given data with BLAKE2b, without a key, and stores
+ * the SIG_HASH_LEN bytes of the digest at the given memory.
+ */
+static void sig_blake2b(unsigned char* out, const unsigned char* data, size_t len) {
+	unsigned char last[128];
+	unsigned char digest[64];
+	uint64_t h[8];
+	uint64_t t;
+	int i;
+
+	// parameter block of the digest length, no key, sequential mode
+	for (i = 0; i < 8; i++) {
+		h[i] = sig_iv[i];
+	}
+	h[0] ^= 0x01010000ULL ^ SIG_HASH_LEN;
+
+	// all blocks but the last are compressed straight from the data
+	t = 0;
+	while (len > 128) {
+		t += 128;
+		sig_compress(h, data, t, 0);
+		data += 128;
+		len -= 128;
+	}
+
+	// last block, padded with zeros
+	memset(last, 0, sizeof(last));
+	memcpy(last, data, len);
+	t += len;
+	sig_compress(h, last, t, 1);
+
+	for (i = 0; i < 8; i++) {
+		sig_store64(digest + (8 * i), h[i]);
+	}
+	memcpy(out, digest, SIG_HASH_LEN);
+}
+
+/**********************************************************/
+/*
+ * Hashes the part of the blocks being hashed given by the index and the number
+ * of parts, for pool_run().
+ */
+static void sig_part(void* arg, int idx, int cnt) {
+	sig* s = (sig*)arg;
+	size_t blocks;
+	size_t first;
+	size_t last;
+	size_t len;
+	size_t i;
+
+	// whole blocks of this part, the last block may be partial
+	blocks = (s->n + s->block - 1) / s->block;
+	first = blocks * idx / cnt;
+	last = blocks * (idx + 1) / cnt;
+
+	for (i = first; i < last; i++) {
+		len = s->n - (i * s->block);
+		if (len > s->block) {
+			len = s->block;
+		}
+		sig_blake2b(s->hash + (i * SIG_HASH_LEN), s->ptr + (i * s->block), len);
+	}
+}
+
+/**********************************************************/
+/*
+ * Allocates and initializes a new signature of blocks of the given size, and
+ * creates the signature file at the given path, or opens it to verify against
+ * it, in which case the block size is then read from its header by
+ * sig_read(). Returns the new structure, or NULL if error.
+ */
+sig* sig_malloc(char* path, int verify, size_t block) {
+	unsigned char header[SIG_HEADER];
+	sig* s;
+
+	// check parameters
+	if (path == NULL || (! verify && block == 0)) {
+		return NULL;
+	}
+
+	// allocate memory for structure
+	s = (sig*)malloc(sizeof(sig));
+	if (s == NULL) {
+		return NULL;
+	}
+
+	// set default values
+	s->verify = verify ? 1 : 0;
+	s->block = block;
+	s->len = 0;
+	s->blocks = 0;
+	s->sig_len = 0;
+	s->sig_blocks = 0;
+	s->diff_blocks = 0;
+	s->diff = NULL;
+	s->ptr = NULL;
+	s->n = 0;
+	s->hash = NULL;
+	s->ref = NULL;
+
+	// open signature file
+	s->fp = fopen(path, verify ? "rb" : "wb");
+	if (s->fp == NULL) {
+		free(s);
+		return NULL;
+	}
+
+	// reserve the header, written once the length is known
+	if (! verify) {
+		memset(header, 0, sizeof(header));
+		if (fwrite(header, sizeof(header), 1, s->fp) != 1) {
+			sig_free(s);
+			return NULL;
+		}
+		return s;
+	}
+
+	// allocate ranges of differing blocks
+	s->diff = range_malloc();
+	if (s->diff == NULL) {
+		sig_free(s);
+		return NULL;
+	}
+
+	return s;
+}
+
+/**********************************************************/
+/*
+ * Reads the header of the signature file to verify against, setting the block
+ * size and the length of the data it was generated from. Returns 0 if
+ * successful, or -1 if the file is not a valid signature.
+ */
+int sig_read(sig* s) {
+	unsigned char header[SIG_HEADER];
+
+	// check parameters
+	if (s == NULL || ! s->verify) {
+		return -1;
+	}
+
+	// read header
+	if (fread(header, sizeof(header), 1, s->fp) != 1
+		|| memcmp(header, SIG_MAGIC, 8) != 0
+		|| sig_load64(header + 24) != SIG_HASH_LEN) {
+		return -1;
+	}
+	s->block = sig_load64(header + 8);
+	s->sig_len = sig_load64(header + 16);
+	if (s->block == 0) {
+		return -1;
+	}
+	s->sig_blocks = (s->sig_len + s->block - 1) / s->block;
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Frees the memory used by the given signature and closes the signature file.
+ * Returns 0 if successful, or -1 if the signature file could not be written.
+ */
+int sig_free(sig* s) {
+	int ret;
+
+	ret = 0;
+	if (s != NULL) {
+		if (s->fp != NULL && fclose(s->fp) != 0) {
+			ret = -1;
+		}
+		range_free(s->diff);
+		free(s->hash);
+		free(s->ref);
+		free(s);
+	}
+
+	return ret;
+}
+
+/**********************************************************/
+/*
+ * Reads up to len bytes of the given open file once, and hashes each block on
+ * the given worker threads, if any. The hashes are either written to the
+ * signature file, or compared with those of the signature file, adding each
+ * differing block to the ranges of differing blocks. Blocks past the end of
+ * the file or of the signature are differing blocks, but a virtual file is only
+ * verified up to the end of the signature. The blocks are hashed from a buffer
+ * of at least buf_size bytes, holding whole blocks for each worker thread.
+ * Returns 0 if successful, or -1 if error.
+ */
+int sig_file(sig* s, sfile* sf, size_t buf_size, size_t len, pool* workers) {
+	unsigned char header[SIG_HEADER];
+	sbuf* sb;
+	size_t size;
+	size_t cnt;
+	size_t blocks;
+	size_t refs;
+	size_t i;
+	size_t pos;
+	size_t end;
+	ssize_t br;
+	int ret;
+
+	// check parameters
+	if (s == NULL || sf == NULL) {
+		return -1;
+	}
+
+	// a virtual file never ends, verify it as long as the signature
+	if (s->verify && sf->pat_len > 0 && len > s->sig_len) {
+		len = s->sig_len;
+	}
+
+	// whole blocks, at least one for each worker thread
+	cnt = (workers != NULL) ? (size_t)workers->cnt : 1;
+	size = buf_size + ((s->block - (buf_size % s->block)) % s->block);
+	if (size < s->block * cnt) {
+		size = s->block * cnt;
+	}
+	blocks = size / s->block;
+
+	// allocate buffer and hashes
+	sb = sf->direct ? sbuf_malloc_aligned(size, SFILE_DIRECT_ALIGN) : sbuf_malloc(size);
+	s->hash = (unsigned char*)malloc(blocks * SIG_HASH_LEN);
+	if (s->verify) {
+		s->ref = (unsigned char*)malloc(blocks * SIG_HASH_LEN);
+	}
+	if (sb == NULL || s->hash == NULL || (s->verify && s->ref == NULL)) {
+		sbuf_free(sb);
+		return -1;
+	}
+
+	ret = 0;
+	while (ret == 0 && s->len < len) {
+
+		// fill the blocks of the buffer, reads may be short for pipes
+		while (sb->len < size && ! sf->eof && sb->len < len - s->len) {
+			br = sfile_read(sf, sb);
+			if (br < 0) {
+				ret = -1;
+				break;
+			}
+		}
+
+		// nothing left to hash
+		s->ptr = sb->ptr;
+		s->n = (sb->len < size) ? sb->len : size;
+		if (s->n > len - s->len) {
+			s->n = len - s->len;
+		}
+		if (ret != 0 || s->n == 0) {
+			break;
+		}
+
+		// hash blocks in parallel
+		if (workers != NULL) {
+			pool_run(workers, sig_part, s);
+		}
+		else {
+			sig_part(s, 0, 1);
+		}
+		blocks = (s->n + s->block - 1) / s->block;
+
+		// compare hashes with the signature, blocks past its end differ
+		if (s->verify) {
+			refs = 0;
+			if (s->blocks < s->sig_blocks) {
+				refs = s->sig_blocks - s->blocks;
+				refs = (refs < blocks) ? refs : blocks;
+				if (fread(s->ref, SIG_HASH_LEN, refs, s->fp) != refs) {
+					ret = -1;
+					break;
+				}
+			}
+			for (i = 0; i < blocks; i++) {
+				if (i >= refs || memcmp(s->hash + (i * SIG_HASH_LEN), s->ref + (i * SIG_HASH_LEN), SIG_HASH_LEN) != 0) {
+
+					// the last block ends at the end of the file or
+					// of the signature, whichever is longer
+					pos = (s->blocks + i) * s->block;
+					end = s->len + s->n;
+					if (end < s->sig_len) {
+						end = s->sig_len;
+					}
+					if (end > pos + s->block) {
+						end = pos + s->block;
+					}
+					if (range_add(s->diff, pos, end - pos) != 0) {
+						ret = -1;
+					}
+					s->diff_blocks++;
+				}
+			}
+		}
+
+		// write hashes to the signature
+		else if (fwrite(s->hash, SIG_HASH_LEN, blocks, s->fp) != blocks) {
+			ret = -1;
+		}
+
+		s->blocks += blocks;
+		s->len += s->n;
+
+		// keep data read past the blocks, a partial block is only ever at
+		// the end
+		sbuf_reduce(sb, sb->pos + s->n);
+	}
+
+	sbuf_free(sb);
+	if (ret != 0) {
+		return -1;
+	}
+
+	// blocks of the signature past the end of the file
+	if (s->verify) {
+		if (s->blocks < s->sig_blocks) {
+			if (range_add(s->diff, s->blocks * s->block, s->sig_len - (s->blocks * s->block)) != 0) {
+				return -1;
+			}
+			s->diff_blocks += s->sig_blocks - s->blocks;
+		}
+		range_sort(s->diff);
+		return 0;
+	}
+
+	// header, now that the length is known
+	memcpy(header, SIG_MAGIC, 8);
+	sig_store64(header + 8, s->block);
+	sig_store64(header + 16, s->len);
+	sig_store64(header + 24, SIG_HASH_LEN);
+	if (fseek(s->fp, 0, SEEK_SET) != 0 || fwrite(header, sizeof(header), 1, s->fp) != 1) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Prints the ranges of differing blocks found by verification, one OFFSET:
+ * LENGTH pair per line, so that they can be given to -L. Unless quiet, the
+ * ranges are preceded by a comment with the number of differing blocks.
+ */
+void sig_print(sig* s, FILE* fp, int quiet) {
+	size_t i;
+
+	if (! quiet) {
+		fprintf(fp, "# %zu of %zu blocks of %zu bytes differ\n", s->diff_blocks, (s->blocks > s->sig_blocks ? s->blocks : s->sig_blocks), s->block);
+	}
+	for (i = 0; i < s->diff->cnt; i++) {
+		fprintf(fp, "0x%08zx:0x%zx\n", s->diff->r[i].pos, s->diff->r[i].end - s->diff->r[i].pos);
+	}
+}
+
+/**********************************************************/
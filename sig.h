@@ -0,0 +1,38 @@
+#ifndef _SIG_H
+#define _SIG_H
+
+#include <stdio.h>
+#include "sbuf.h"
+#include "pool.h"
+#include "range.h"
+
+#define SIG_MAGIC		"hexdsig1"	// first bytes of a signature file
+#define SIG_HEADER		32		// number of bytes of the header
+#define SIG_HASH_LEN		32		// number of bytes of the hash of a block
+#define SIG_BLOCK_SIZE		(size_t)65536	// default number of bytes per block
+
+// signature of the blocks of a file
+struct sig {
+	FILE* fp;		// signature file
+	int verify;		// flag to verify against the signature instead of generating it
+	size_t block;		// number of bytes per block
+	size_t len;		// number of bytes hashed
+	size_t blocks;		// number of blocks hashed
+	size_t sig_len;		// number of bytes of the signature file's data (verify only)
+	size_t sig_blocks;	// number of blocks of the signature file (verify only)
+	size_t diff_blocks;	// number of differing blocks (verify only)
+	range_list* diff;	// ranges of differing blocks (verify only)
+	unsigned char* ptr;	// data of the blocks being hashed
+	size_t n;		// number of bytes of the blocks being hashed
+	unsigned char* hash;	// hashes of the blocks being hashed
+	unsigned char* ref;	// hashes of the signature file (verify only)
+};
+typedef struct sig sig;
+
+sig* sig_malloc(char* path, int verify, size_t block);
+int sig_read(sig* s);
+int sig_free(sig* s);
+int sig_file(sig* s, sfile* sf, size_t buf_size, size_t len, pool* workers);
+void sig_print(sig* s, FILE* fp, int quiet);
+
+#endif /* _SIG_H */
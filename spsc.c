@@ -0,0 +1,184 @@
+/*
+ * spsc - single-producer single-consumer queue
+ *
+ * Provides a bounded lock-free queue of generic pointers between exactly two
+ * threads, one which only pushes and one which only pops. The head and tail
+ * are each written by only one thread, so no locks or compare-and-swap are
+ * needed, only acquire and release ordering.
+ *
+ * It is the caller's responsibility to allocate and free the objects passed
+ * through the queue. The queue itself is allocated with spsc_malloc() and
+ * freed with spsc_free().
+ */
+
+#include <stdio.h>		// NULL
+#include <stdlib.h>		// malloc(), free()
+#include <sched.h>		// sched_yield()
+#include <time.h>		// nanosleep()
+#include "spsc.h"
+
+#define SPSC_SPINS		64	// attempts before yielding
+#define SPSC_YIELDS		1024	// attempts before sleeping
+#define SPSC_SLEEP		50000	// nanoseconds to sleep when idle
+
+/**********************************************************/
+/*
+ * Waits after the given number of failed attempts, first by retrying
+ * immediately, then by yielding the processor and finally by sleeping, so that
+ * a waiting thread does not consume a processor while another stage is
+ * blocked on I/O.
+ */
+static void spsc_backoff(size_t attempt) {
+	struct timespec ts;
+
+	// retry immediately
+	if (attempt < SPSC_SPINS) {
+	}
+
+	// yield
+	else if (attempt < SPSC_YIELDS) {
+		sched_yield();
+	}
+
+	// sleep
+	else {
+		ts.tv_sec = 0;
+		ts.tv_nsec = SPSC_SLEEP;
+		nanosleep(&ts, NULL);
+	}
+}
+
+/**********************************************************/
+/*
+ * Allocates memory and initializes a new queue which can hold at least the
+ * given number of pointers. Returns the new queue, or NULL if error.
+ */
+spsc* spsc_malloc(size_t size) {
+	spsc* q;
+	size_t slots;
+
+	// check parameters
+	if (size == 0) {
+		return NULL;
+	}
+
+	// round up to a power of two, so positions can be masked
+	slots = 1;
+	while (slots < size) {
+		slots <<= 1;
+	}
+
+	// allocate queue
+	q = (spsc*)aligned_alloc(SPSC_CACHE_LINE, sizeof(spsc));
+	if (q == NULL) {
+		return NULL;
+	}
+
+	// allocate slots
+	q->slot = (void**)malloc(slots * sizeof(void*));
+	if (q->slot == NULL) {
+		free(q);
+		return NULL;
+	}
+
+	// set default values
+	q->mask = slots - 1;
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+
+	return q;
+}
+
+/**********************************************************/
+/*
+ * Frees all memory associated with the given queue. Objects still in the
+ * queue are not freed.
+ */
+void spsc_free(spsc* q) {
+
+	// check parameters
+	if (q == NULL) {
+		return;
+	}
+
+	free(q->slot);
+	free(q);
+}
+
+/**********************************************************/
+/*
+ * Pushes the given pointer at the end of the queue. Must only be called by the
+ * producer thread. Returns 0 if successful, or -1 if the queue is full.
+ */
+int spsc_push(spsc* q, void* obj) {
+	size_t tail;
+
+	// position is only written by this thread
+	tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+	// queue is full
+	if (tail - atomic_load_explicit(&q->head, memory_order_acquire) > q->mask) {
+		return -1;
+	}
+
+	// store pointer before publishing it to the consumer
+	q->slot[tail & q->mask] = obj;
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+	return 0;
+}
+
+/**********************************************************/
+/*
+ * Pops a pointer from the beginning of the queue. Must only be called by the
+ * consumer thread. Returns the pointer, or NULL if the queue is empty.
+ */
+void* spsc_pop(spsc* q) {
+	size_t head;
+	void* obj;
+
+	// position is only written by this thread
+	head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+	// queue is empty
+	if (head == atomic_load_explicit(&q->tail, memory_order_acquire)) {
+		return NULL;
+	}
+
+	// load pointer before releasing the slot to the producer
+	obj = q->slot[head & q->mask];
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+
+	return obj;
+}
+
+/**********************************************************/
+/*
+ * Pushes the given pointer at the end of the queue, waiting while the queue is
+ * full.
+ */
+void spsc_push_wait(spsc* q, void* obj) {
+	size_t attempt;
+
+	for (attempt = 0; spsc_push(q, obj) != 0; attempt++) {
+		spsc_backoff(attempt);
+	}
+}
+
+/**********************************************************/
+/*
+ * Pops a pointer from the beginning of the queue, waiting while the queue is
+ * empty. NULL pointers must not be pushed to a queue used with this function.
+ */
+void* spsc_pop_wait(spsc* q) {
+	size_t attempt;
+	void* obj;
+
+	for (attempt = 0; (obj = spsc_pop(q)) == NULL; attempt++) {
+		spsc_backoff(attempt);
+	}
+
+	return obj;
+}
+
+/**********************************************************/
@@ -0,0 +1,27 @@
+#ifndef _SPSC_H
+#define _SPSC_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// size of a cache line, to keep the head and tail apart
+#define SPSC_CACHE_LINE		64
+
+// queue
+struct spsc {
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t head;	// next slot to pop (consumer)
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t tail;	// next slot to push (producer)
+	_Alignas(SPSC_CACHE_LINE) void** slot;		// ring of generic pointers
+	size_t mask;					// number of slots minus one
+};
+typedef struct spsc spsc;
+
+// spsc functions
+spsc* spsc_malloc(size_t size);
+void spsc_free(spsc* q);
+int spsc_push(spsc* q, void* obj);
+void* spsc_pop(spsc* q);
+void spsc_push_wait(spsc* q, void* obj);
+void* spsc_pop_wait(spsc* q);
+
+#endif /* _SPSC_H */
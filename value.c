@@ -0,0 +1,40 @@
+/*
+ * value - numeric values
+ *
+ * Provides the parser of the numeric values of options, ranges and regions,
+ * given as a hexadecimal value prepended with 0x or as a decimal value, so
+ * that every value is accepted the same way.
+ */
+
+#include <stdlib.h>		// strtoull()
+#include <string.h>		// strncmp()
+#include <ctype.h>		// isdigit(), isxdigit()
+#include "value.h"
+
+/**********************************************************/
+/*
+ * Parses a hexadecimal value prepended with 0x or a decimal value at the
+ * given string, and sets the end of the value. Unlike strtoull(), the value
+ * must start with a digit, so a sign or leading spaces are not a value.
+ * Returns 0 if successful, or -1 if there is no value.
+ */
+int value_parse(char* str, char** end, size_t* value) {
+
+	*end = str;
+
+	if (strncmp(str, "0x", 2) == 0) {
+		if (! isxdigit((unsigned char)str[2])) {
+			return -1;
+		}
+		*value = strtoull(str + 2, end, 16);
+		return 0;
+	}
+
+	if (! isdigit((unsigned char)str[0])) {
+		return -1;
+	}
+	*value = strtoull(str, end, 10);
+	return 0;
+}
+
+/**********************************************************/
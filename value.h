@@ -0,0 +1,8 @@
+#ifndef _VALUE_H
+#define _VALUE_H
+
+#include <stddef.h>
+
+int value_parse(char* str, char** end, size_t* value);
+
+#endif /* _VALUE_H */